@@ -5,6 +5,9 @@
 #include <type_traits>
 #include <cassert>
 
+// reports an out of bounds access through ErrorState::pixi_error, so it ends the insertion instead of the process
+[[noreturn]] void array_index_error(size_t size, size_t index);
+
 template <typename T, typename = std::enable_if_t<sizeof(T) == 1>>
 class ByteIterator {
 	T* m_current;
@@ -156,8 +159,7 @@ public:
 
 	T& at(size_t index) const {
 		if (index >= size()) {
-			printf("[ ARRAY ] Trying to access array of size %zd with index of size %zd\n", size(), index);
-			exit(-1);
+			array_index_error(size(), index);
 		}
 		return m_start[index];
 	}
@@ -212,6 +214,14 @@ public:
 		return fread(m_start, sizeof(T), m_size, fp);
 	}
 
+	size_t from_buffer(const T* src, size_t size) {
+		if (size > m_capacity)
+			resize(size);
+		m_size = size;
+		memcpy(m_start, src, m_size * sizeof(T));
+		return m_size;
+	}
+
 	void write(const T* src, size_t size) {
 		memcpy(m_start, src, size);
 	}
@@ -255,8 +265,7 @@ public:
 
 	constexpr const T& at(size_t index) const {
 		if (index >= size) {
-			printf("[ ARRAY ] Trying to access array of size %zd with index of size %zd\n", size, index);
-			exit(-1);
+			array_index_error(size, index);
 		}
 		return ptr[index];
 	}
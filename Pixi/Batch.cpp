@@ -0,0 +1,324 @@
+#include "Pixi.h"
+#include <map>
+#include <memory>
+#include <thread>
+
+#ifndef WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+struct BatchRom {
+	PixiConfig cfg{};
+	size_t group = 0;
+	int retval = 1;
+	std::string output{};
+	std::string error{};
+};
+
+// roms that resolve to the same list file share the parsed sprites
+struct BatchGroup {
+	std::unique_ptr<SpritesData> sprdata{};
+	std::vector<std::string> extraDefines{};
+	std::string error{};
+};
+
+static std::string first_line(std::string message) {
+	auto newline = message.find('\n');
+	if (newline != std::string::npos)
+		message.erase(newline);
+	return message;
+}
+
+// one rom per line, ; starts a comment, relative paths are relative to the folder of the manifest
+static std::vector<std::string> read_manifest(const std::string& manifest) {
+	FILE* fp = fileopen(manifest.c_str(), "r");
+	std::filesystem::path base = std::filesystem::absolute(manifest).parent_path();
+	std::vector<std::string> roms{};
+	char cline[1024];
+	while (fgets(cline, 1024, fp) != NULL) {
+		std::string line = cline;
+		if (line.find(';') != std::string::npos)
+			line.erase(line.find(';'));
+		trim(line);
+		if (line.empty())
+			continue;
+		std::filesystem::path path{ line };
+		roms.push_back(path.is_absolute() ? line : (base / path).lexically_normal().string());
+	}
+	fclose(fp);
+	return roms;
+}
+
+static void parse_group(BatchGroup& group, PixiConfig& cfg) {
+	try {
+		group.sprdata = std::make_unique<SpritesData>(cfg);
+		group.extraDefines = cfg.list_extra_asm("/ExtraDefines");
+		group.sprdata->populate(cfg);
+	}
+	catch (const PixiException& e) {
+		group.sprdata.reset();
+		group.error = e.what();
+	}
+}
+
+#ifdef WIN32
+
+// no fork: every rom parses the list again and they're inserted one at a time
+static void run_batch(std::vector<BatchRom>& roms, std::vector<BatchGroup>&, unsigned) {
+	ErrorState::keep_asar_loaded = true;
+	for (BatchRom& rom : roms) {
+		fmt::print("\n-------- {} --------\n", rom.cfg.RomName);
+		BatchGroup group{};
+		parse_group(group, rom.cfg);
+		if (!group.error.empty()) {
+			rom.error = group.error;
+			continue;
+		}
+		try {
+			rom.retval = run_pixi_parsed(rom.cfg, *group.sprdata, group.extraDefines);
+			if (rom.retval != 0)
+				rom.error = "MeiMei failed to remap the sprite data, the rom has been reverted";
+		}
+		catch (const PixiException& e) {
+			rom.error = e.what();
+			rom.retval = 1;
+		}
+	}
+	ErrorState::keep_asar_loaded = false;
+}
+
+#else
+
+static void print_rom_output(const BatchRom& rom) {
+	fmt::print("\n-------- {} --------\n", rom.cfg.RomName);
+	fwrite(rom.output.data(), 1, rom.output.size(), stdout);
+	fflush(stdout);
+}
+
+struct RunningRom {
+	pid_t pid = -1;
+	int fd = -1;
+	size_t index = 0;
+};
+
+// the child inherits the already parsed sprites, everything it prints goes to the pipe
+// followed by a 0 byte and the error message if the insertion failed
+static bool start_rom(std::vector<BatchRom>& roms, std::vector<BatchGroup>& groups, size_t index, std::vector<RunningRom>& running) {
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		for (const RunningRom& other : running)
+			close(other.fd);
+		int devnull = open("/dev/null", O_RDONLY);
+		if (devnull >= 0) {
+			dup2(devnull, STDIN_FILENO);
+			close(devnull);
+		}
+		dup2(fds[1], STDOUT_FILENO);
+		dup2(fds[1], STDERR_FILENO);
+		close(fds[1]);
+		BatchRom& rom = roms[index];
+		std::string error{};
+		int retval = 1;
+		try {
+			retval = run_pixi_parsed(rom.cfg, *groups[rom.group].sprdata, groups[rom.group].extraDefines);
+			if (retval != 0)
+				error = "MeiMei failed to remap the sprite data, the rom has been reverted";
+		}
+		catch (const PixiException& e) {
+			error = e.what();
+			ErrorState::asar_close_wrap();
+		}
+		fflush(stdout);
+		if (!error.empty()) {
+			fputc('\0', stdout);
+			fputs(error.c_str(), stdout);
+			fflush(stdout);
+		}
+		exit(retval);
+	}
+	close(fds[1]);
+	running.push_back({ pid, fds[0], index });
+	return true;
+}
+
+static void finish_rom(BatchRom& rom, RunningRom& child) {
+	close(child.fd);
+	int status = 0;
+	while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR) {}
+	rom.retval = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+	auto separator = rom.output.find('\0');
+	if (separator != std::string::npos) {
+		rom.error = rom.output.substr(separator + 1);
+		rom.output.erase(separator);
+	}
+	if (rom.retval != 0 && rom.error.empty())
+		rom.error = WIFSIGNALED(status) ? fmt::format("Insertion crashed with signal {}", WTERMSIG(status)) : "Insertion failed";
+	print_rom_output(rom);
+}
+
+static void run_batch(std::vector<BatchRom>& roms, std::vector<BatchGroup>& groups, unsigned jobs) {
+	std::vector<RunningRom> running{};
+	size_t next = 0;
+	while (next < roms.size() || !running.empty()) {
+		while (running.size() < jobs && next < roms.size()) {
+			BatchRom& rom = roms[next];
+			if (!groups[rom.group].error.empty())
+				rom.error = groups[rom.group].error;
+			else if (!start_rom(roms, groups, next, running))
+				rom.error = fmt::format("Couldn't start the insertion: {}", strerror(errno));
+			next++;
+		}
+		if (running.empty())
+			continue;
+		std::vector<pollfd> pfds{};
+		for (const RunningRom& child : running)
+			pfds.push_back({ child.fd, POLLIN, 0 });
+		if (poll(pfds.data(), pfds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ErrorState::pixi_error("Waiting for the batch insertions failed: {}\n", strerror(errno));
+		}
+		for (size_t i = running.size(); i-- > 0;) {
+			if (pfds[i].revents == 0)
+				continue;
+			char buf[0x1000];
+			ssize_t got = read(running[i].fd, buf, sizeof(buf));
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got > 0) {
+				roms[running[i].index].output.append(buf, (size_t)got);
+				continue;
+			}
+			finish_rom(roms[running[i].index], running[i]);
+			running.erase(running.begin() + i);
+		}
+	}
+}
+
+#endif
+
+int pixi_batch(int argc, char* argv[]) {
+	std::vector<std::string> args(argv + 2, argv + argc);
+	std::vector<std::string> rom_names{};
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+	auto separator = std::find(args.begin(), args.end(), "--");
+	bool separated = separator != args.end();
+	if (separated) {
+		rom_names.assign(separator + 1, args.end());
+		args.erase(separator, args.end());
+	}
+	bool manifest = false;
+	for (auto it = args.begin(); it != args.end();) {
+		if (*it != "-j" && *it != "--manifest") {
+			++it;
+			continue;
+		}
+		if (it + 1 == args.end())
+			ErrorState::pixi_error("Requiring next parameter for {} failed\n", *it);
+		if (*it == "-j") {
+			jobs = (unsigned)std::max(1, std::atoi((it + 1)->c_str()));
+		}
+		else {
+			auto listed = read_manifest(*(it + 1));
+			rom_names.insert(rom_names.end(), listed.begin(), listed.end());
+			manifest = true;
+		}
+		it = args.erase(it, it + 2);
+	}
+	// without -- or a manifest, every argument is a rom
+	if (!separated && !manifest) {
+		for (const std::string& arg : args) {
+			if (!arg.empty() && arg[0] == '-')
+				ErrorState::pixi_error("Options for --batch have to be separated from the roms with --, found \"{}\"\n", arg);
+		}
+		rom_names = std::move(args);
+		args.clear();
+	}
+	if (rom_names.empty())
+		ErrorState::pixi_error("Usage: pixi --batch [-j <jobs>] <options> -- <ROM> <ROM>...\n"
+			"       pixi --batch [-j <jobs>] <options> --manifest <file>\n");
+
+	std::vector<char*> cfg_args{};
+	cfg_args.push_back(argv[0]);
+	for (std::string& arg : args)
+		cfg_args.push_back(arg.data());
+	cfg_args.push_back(rom_names.front().data());
+	const PixiConfig base{ (int)cfg_args.size(), cfg_args.data() };
+	if (base.Help)
+		return 0;
+
+	// temporary files are written in the asm folder, which every insertion shares
+	if (base.KeepFiles || base.m_meimei.keep) {
+		if (jobs > 1)
+			fmt::print("Temporary files are kept (-k or -meimei-k), the roms will be inserted one at a time\n");
+		jobs = 1;
+	}
+
+	std::vector<BatchRom> roms(rom_names.size());
+	std::vector<BatchGroup> groups{};
+	std::map<std::string, size_t> group_of_list{};
+	std::map<std::string, std::string> owner_of_subfiles{};
+	for (size_t i = 0; i < rom_names.size(); i++) {
+		BatchRom& rom = roms[i];
+		rom.cfg = base;
+		rom.cfg.RomName = rom_names[i];
+		rom.cfg.correct_paths();
+		std::error_code ec{};
+		std::string subfiles = std::filesystem::weakly_canonical(std::filesystem::absolute(rom.cfg.RomName).replace_extension(), ec).string();
+		auto [owner, inserted] = owner_of_subfiles.emplace(subfiles, rom.cfg.RomName);
+		if (!inserted)
+			ErrorState::pixi_error("\"{}\" and \"{}\" would overwrite each other's .ssc/.mwt/.mw2/.s16 files\n", owner->second, rom.cfg.RomName);
+		auto [group, added] = group_of_list.emplace(rom.cfg.m_Paths[PathType::List], groups.size());
+		rom.group = group->second;
+		if (added)
+			groups.emplace_back();
+	}
+
+#ifndef WIN32
+	// the list and every sprite descriptor are parsed once per list, the children get a copy of the result
+	std::vector<bool> parsed(groups.size(), false);
+	for (BatchRom& rom : roms) {
+		if (parsed[rom.group])
+			continue;
+		parsed[rom.group] = true;
+		parse_group(groups[rom.group], rom.cfg);
+		// warnings found while parsing have to be emitted by every rom of the group
+		for (BatchRom& other : roms) {
+			if (other.group == rom.group && &other != &rom)
+				other.cfg.WarningList = rom.cfg.WarningList;
+		}
+	}
+	fmt::print("Inserting into {} roms ({} parsed lists, {} at a time)\n", roms.size(), groups.size(), std::min<size_t>(jobs, roms.size()));
+#endif
+	run_batch(roms, groups, jobs);
+
+	size_t succeeded = 0;
+	fmt::print("\n-------- Batch results --------\n");
+	for (const BatchRom& rom : roms) {
+		if (rom.retval == 0 && rom.error.empty()) {
+			succeeded++;
+			fmt::print("\t{}: inserted\n", rom.cfg.RomName);
+		}
+		else {
+			fmt::print("\t{}: failed, {}\n", rom.cfg.RomName, first_line(rom.error));
+		}
+	}
+	fmt::print("{} of {} roms inserted successfully\n", succeeded, roms.size());
+	return succeeded == roms.size() ? 0 : 1;
+}
\ No newline at end of file
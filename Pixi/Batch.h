@@ -0,0 +1,6 @@
+#pragma once
+
+// batch mode: `pixi --batch [-j <jobs>] <options> -- <ROM> <ROM>...` or `pixi --batch [-j <jobs>] <options> --manifest <file>`
+// inserts the same sprites into several roms, the list and the sprite descriptors are parsed only once per list file.
+// on POSIX systems every rom is inserted in a forked child, up to <jobs> at the same time, elsewhere they're done one after the other.
+int pixi_batch(int argc, char* argv[]);
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "Pixi.h"
+#include "Bench.h"
+#include "Cpu65816.h"
+#include <algorithm>
+#include <functional>
+
+// master clocks of a scanline, to put the numbers in perspective
+static constexpr int SCANLINE_CLOCKS = 1364;
+// a call that runs longer than this is reported as not returning
+static constexpr int STEP_LIMIT = 100000;
+// the hijacks called with JSL return to this bank, nothing pixi inserts runs there
+static constexpr uint8_t RETURN_BANK = 0x7F;
+
+// where sa1def.asm puts what the hijacks read
+struct BenchRam {
+	uint16_t dp;
+	uint16_t addr;
+	uint32_t extra_bits;
+	uint32_t extra_prop_2;
+	uint32_t new_sprite_num;
+	uint32_t sprite_status;
+	// for the fake level data SprtOffset reads through $CE
+	uint32_t level_data;
+};
+
+static constexpr BenchRam LOROM_RAM{ 0x0000, 0x0000, 0x7FAB10, 0x7FAB34, 0x7FAB9E, 0x0014C8, 0x7EC800 };
+static constexpr BenchRam SA1_RAM{ 0x3000, 0x6000, 0x006040, 0x00606D, 0x006083, 0x003242, 0x40C800 };
+
+struct BenchStats {
+	std::string name;
+	int calls = 0;
+	int failures = 0;
+	uint64_t min_cycles = std::numeric_limits<uint64_t>::max();
+	uint64_t max_cycles = 0;
+	uint64_t total_cycles = 0;
+	uint64_t min_clocks = std::numeric_limits<uint64_t>::max();
+	uint64_t max_clocks = 0;
+	uint64_t total_clocks = 0;
+};
+
+class Bench {
+	Rom& m_rom;
+	SnesBus m_bus;
+	bool m_sa1;
+	bool m_fastrom;
+	bool m_verbose;
+	bool m_planar;
+	const BenchRam& m_ram;
+	std::vector<BenchStats> m_stats{};
+
+	// every hijack pixi puts at a vanilla address, 0 if the rom doesn't have it
+	uint32_t hijack_target(uint32_t hook, uint8_t opcode) {
+		if (m_bus.read(hook) != opcode)
+			return 0;
+		return m_bus.read_long(hook + 1);
+	}
+
+	uint32_t table_pointer(uint32_t table, int index) {
+		if (m_planar)
+			return m_bus.read(table + index) | (m_bus.read(table + index + Sprite::SPRITE_COUNT) << 8) |
+				(m_bus.read(table + index + 2 * Sprite::SPRITE_COUNT) << 16);
+		return m_bus.read_long(table + index * 3);
+	}
+
+	BenchStats& stats(std::string_view name) {
+		for (BenchStats& s : m_stats) {
+			if (s.name == name)
+				return s;
+		}
+		m_stats.push_back(BenchStats{ std::string{ name } });
+		return m_stats.back();
+	}
+
+	// runs from the target of the hijack at hook until it returns (JSL) or jumps to one of exits (JML)
+	// the sprites themselves aren't measured: every JML [abs] is the call of one, which returns right away
+	bool run(std::string_view name, std::string_view label, uint32_t hook, uint8_t opcode, std::initializer_list<uint32_t> exits,
+		const std::function<void(Cpu65816&)>& setup, bool measured = true) {
+		uint32_t target = hijack_target(hook, opcode);
+		if (target == 0)
+			return false;
+		Cpu65816 cpu{ m_bus };
+		cpu.d = m_ram.dp;
+		cpu.db = m_fastrom ? 0x81 : 0x01;
+		cpu.pb = target >> 16;
+		cpu.pc = target & 0xFFFF;
+		if (opcode == 0x22 || exits.size() == 0) {
+			cpu.push8(RETURN_BANK);
+			cpu.push8(((hook + 3) >> 8) & 0xFF);
+			cpu.push8((hook + 3) & 0xFF);
+		}
+		setup(cpu);
+		cpu.cycles = 0;
+		cpu.clocks = 0;
+
+		std::string error{};
+		for (int steps = 0; error.empty(); steps++) {
+			if (cpu.pb == RETURN_BANK || std::find(exits.begin(), exits.end(), cpu.address() & 0x7FFFFF) != exits.end())
+				break;
+			if (steps == STEP_LIMIT) {
+				error = fmt::format("didn't return after {} instructions", STEP_LIMIT);
+				break;
+			}
+			cpu.step();
+			if (cpu.halted())
+				error = cpu.halt_reason();
+			else if (cpu.jumped_indirect())
+				cpu.return_long();
+		}
+		if (!measured)
+			return error.empty();
+
+		BenchStats& s = stats(name);
+		s.calls++;
+		if (!error.empty()) {
+			s.failures++;
+			fmt::print("{} {}: {}\n", name, label, error);
+			return false;
+		}
+		s.min_cycles = std::min(s.min_cycles, cpu.cycles);
+		s.max_cycles = std::max(s.max_cycles, cpu.cycles);
+		s.total_cycles += cpu.cycles;
+		s.min_clocks = std::min(s.min_clocks, cpu.clocks);
+		s.max_clocks = std::max(s.max_clocks, cpu.clocks);
+		s.total_clocks += cpu.clocks;
+		if (m_verbose)
+			fmt::print("{} {}: {} cycles, {} master clocks\n", name, label, cpu.cycles, cpu.clocks);
+		return true;
+	}
+
+	void spawn(int number, uint8_t status) {
+		m_bus.write(m_ram.extra_bits, 0x08);
+		m_bus.write(m_ram.new_sprite_num, number);
+		m_bus.write(m_ram.sprite_status, status);
+	}
+
+	bool sprite_init(int number, bool measured) {
+		return run("SubInitHack", fmt::format("sprite {:02X}", number), 0x018172, 0x22, {}, [&](Cpu65816& cpu) {
+			spawn(number, 0x01);
+			cpu.x = 0;
+		}, measured);
+	}
+
+	void bench_sprites() {
+		uint32_t table = m_bus.read_long(0x02FFEE);
+		for (int number = 0; number < 0x100; number++) {
+			// new_code_flag, tweaks don't run any code of their own
+			if (m_bus.read(table + number * 0x10) == 0)
+				continue;
+			std::string label = fmt::format("sprite {:02X}", number);
+
+			m_bus.clear();
+			run("SetSpriteTables", label, 0x0187A7, 0x5C, {}, [&](Cpu65816& cpu) {
+				spawn(number, 0x01);
+				cpu.x = 0;
+			});
+
+			// the main routine runs after the init did, like in the game
+			m_bus.clear();
+			sprite_init(number, true);
+			run("SubCodeHack", label, 0x0185C3, 0x22, {}, [&](Cpu65816& cpu) {
+				cpu.x = 0;
+			});
+
+			static constexpr std::array<uint8_t, 5> statuses{ 0x07, 0x09, 0x0A, 0x0B, 0x0C };
+			for (uint8_t status : statuses) {
+				m_bus.clear();
+				sprite_init(number, false);
+				run("SubHandleStatus (CallStatusPtr)", fmt::format("{} status {:02X}", label, status), 0x018127, 0x5C,
+					{ 0x0185C2, 0x0185C3, 0x018133 }, [&](Cpu65816& cpu) {
+					m_bus.write(m_ram.sprite_status, status);
+					cpu.x = 0;
+				});
+			}
+
+			m_bus.clear();
+			run("SprtOffset", label, 0x02A846, 0x5C, { 0x02A82E }, [&](Cpu65816& cpu) {
+				// YYYYEEsy with the extra bits of a custom sprite, X, number
+				m_bus.write(m_ram.level_data, 0x08);
+				m_bus.write(m_ram.level_data + 2, number);
+				m_bus.write(m_ram.dp + 0xCE, m_ram.level_data & 0xFF);
+				m_bus.write(m_ram.dp + 0xCF, (m_ram.level_data >> 8) & 0xFF);
+				m_bus.write(m_ram.dp + 0xD0, m_ram.level_data >> 16);
+				if (m_sa1)
+					cpu.set_p(cpu.p & ~Cpu65816::X);
+				cpu.x = 0;
+				cpu.y = 1;
+			});
+		}
+	}
+
+	void bench_cluster() {
+		uint32_t table = m_bus.read_long(0x00A68A);
+		if (m_bus.read(0x02F815) != 0x5C || table == 0x9C1498)
+			return;
+		for (int number = 0; number < Sprite::SPRITE_COUNT; number++) {
+			if ((table_pointer(table, number) >> 16) == 0)
+				continue;
+			m_bus.clear();
+			run("Cluster Main (CallSprite)", fmt::format("cluster {:02X}", number), 0x02F815, 0x5C, { 0x02F81D, 0x02F821 },
+				[&](Cpu65816& cpu) {
+				m_bus.write(m_ram.addr | 0x0100, 0x14);
+				m_bus.write(m_ram.addr | 0x1892, number + 0x09);
+				cpu.x = 0;
+			});
+		}
+	}
+
+	void bench_extended() {
+		uint32_t table = m_bus.read_long(0x029B1F);
+		if (m_bus.read(0x029B1B) != 0x5C || table == 0x176FBC)
+			return;
+		for (int number = 0; number < Sprite::SPRITE_COUNT; number++) {
+			if ((table_pointer(table, number) >> 16) == 0)
+				continue;
+			std::string label = fmt::format("extended {:02X}", number);
+			m_bus.clear();
+			run("Extended Main (CallSprite)", label, 0x029B1B, 0x5C, { 0x029B15, 0x029B27 }, [&](Cpu65816& cpu) {
+				m_bus.write(m_ram.addr | 0x170B, number + 0x13);
+				cpu.a = number + 0x13;
+				cpu.x = 0;
+			});
+			m_bus.clear();
+			run("CapeInteract (CallExtCape)", label, 0x029633, 0x5C, { 0x029656, 0x02963B, 0x02963D }, [&](Cpu65816& cpu) {
+				m_bus.write(m_ram.addr | 0x170B, number + 0x13);
+				cpu.x = 0;
+			});
+		}
+	}
+
+public:
+	Bench(Rom& rom, BusClock clock, bool verbose) :
+		m_rom(rom), m_bus(rom, clock), m_sa1(m_bus.sa1()), m_fastrom(m_bus.fastrom()), m_verbose(verbose),
+		m_planar((m_bus.read(0x02FFE7) & PixiConfig::FLAG_PLANAR) != 0), m_ram(m_sa1 ? SA1_RAM : LOROM_RAM) {}
+
+	bool inserted() {
+		return m_bus.read(0x02FFE2) == 'S' && m_bus.read(0x02FFE3) == 'T' && m_bus.read(0x02FFE4) == 'S' &&
+			m_bus.read(0x02FFE5) == 'D';
+	}
+
+	int run_all() {
+		fmt::print("{}, {}\n", MapperToString(m_rom.mapper()),
+			m_bus.sa1_clock() ? "SA-1 at 10.74 MHz" : (m_fastrom ? "S-CPU with FastROM" : "S-CPU with SlowROM"));
+		bench_sprites();
+		bench_cluster();
+		bench_extended();
+		if (m_stats.empty()) {
+			fmt::print("No custom sprites found\n");
+			return 0;
+		}
+		int failures = 0;
+		fmt::print("\n{:<34}{:>6}  {:<24}{:<28}{}\n", "Entry point", "Calls", "Cycles min/avg/max",
+			"Master clocks min/avg/max", "Scanlines (avg)");
+		for (const BenchStats& s : m_stats) {
+			failures += s.failures;
+			int measured = s.calls - s.failures;
+			if (measured == 0) {
+				fmt::print("{:<34}{:>6}  never returned\n", s.name, s.calls);
+				continue;
+			}
+			double cycles = static_cast<double>(s.total_cycles) / measured;
+			double clocks = static_cast<double>(s.total_clocks) / measured;
+			fmt::print("{:<34}{:>6}  {:<24}{:<28}{:.2f}\n", s.name, s.calls,
+				fmt::format("{}/{:.1f}/{}", s.min_cycles, cycles, s.max_cycles),
+				fmt::format("{}/{:.1f}/{}", s.min_clocks, clocks, s.max_clocks), clocks / SCANLINE_CLOCKS);
+		}
+		return failures == 0 ? 0 : 1;
+	}
+};
+
+int pixi_bench(int argc, char* argv[]) {
+	bool verbose = false;
+	BusClock clock = BusClock::Auto;
+	std::string romname{};
+	for (int i = 2; i < argc; i++) {
+		std::string_view arg{ argv[i] };
+		if (arg == "-v") {
+			verbose = true;
+		}
+		else if (arg == "-clock") {
+			std::string_view value = i + 1 < argc ? argv[++i] : "";
+			if (value == "auto")
+				clock = BusClock::Auto;
+			else if (value == "s-cpu")
+				clock = BusClock::SCpu;
+			else if (value == "sa1")
+				clock = BusClock::Sa1;
+			else
+				ErrorState::pixi_error("-clock has to be followed by auto, s-cpu or sa1, not \"{}\"\n", value);
+		}
+		else if (romname.empty()) {
+			romname = arg;
+		}
+		else {
+			ErrorState::pixi_error("Unexpected argument {}, usage: pixi --bench [-v] [-clock auto|s-cpu|sa1] <ROM>\n", arg);
+		}
+	}
+	if (romname.empty())
+		ErrorState::pixi_error("No ROM given, usage: pixi --bench [-v] [-clock auto|s-cpu|sa1] <ROM>\n");
+
+	Rom rom{ romname };
+	Bench bench{ rom, clock, verbose };
+	if (!bench.inserted())
+		ErrorState::pixi_error("{} doesn't have sprites inserted by PIXI\n", romname);
+	fmt::print("Benchmarking {}: ", romname);
+	return bench.run_all();
+}
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+
+// bench mode: `pixi --bench [-v] [-clock auto|s-cpu|sa1] <ROM>`
+// runs the hijacks pixi inserted in the rom on a 65816 interpreter for every custom sprite it finds in the tables
+// and reports the cycles and master clocks each call took, with the timings of the S-CPU (SlowROM or FastROM) or of the SA-1.
+// -clock picks the timings, by default they're those of the cpu the sprites run on.
+int pixi_bench(int argc, char* argv[]);
\ No newline at end of file
@@ -1,4 +1,12 @@
 #include "Config.h"
+#include "Routines.h"
+#include "Server.h"
+
+bool is_generated_file(std::string_view name) {
+	if (name == "config.asm" || name == "shared.asm" || name == PixiConfig::TEMP_SPR_FILE)
+		return true;
+	return name.size() > 0 && name[0] == '_' && (ends_with(name.data(), ".bin") || name == "_cleanup.asm" || name == "_routines.asm" || name == "_prelude.asm" || name == "_main_pass.asm");
+}
 
 PixiConfig::PixiConfig(int argc, char* argv[]) {
 
@@ -56,6 +64,8 @@ void PixiConfig::parse_noargs_config_file() {
 			KeepFiles = config_table["keeptemp"].value_or(false);
 			PerLevel = config_table["perlevel"].value_or(false);
 			disable255Sprites = config_table["disable255sprites"].value_or(false);
+			FastRom = config_table["fastrom"].value_or(false);
+			PlanarPointers = config_table["planarpointers"].value_or(false);
 			ExtMod = config_table["extmod"].value_or(true);
 			DisableMeiMei = config_table["disablemeimei"].value_or(false);
 			Warnings = config_table["warnings"].value_or(false);
@@ -95,6 +105,8 @@ void PixiConfig::parse_noargs_config_file() {
 			{"keeptemp", false},
 			{"perlevel", false},
 			{"disable255sprites", false},
+			{"fastrom", false},
+			{"planarpointers", false},
 			{"extmod", true},
 			{"disablemeimei", false},
 			{"warnings", false},
@@ -149,8 +161,10 @@ void PixiConfig::parse_cmd_line_args(const std::vector<std::string>& vargv)
 	Iter end = vargv.cend();
 	for (Iter it = vargv.cbegin(); it != end; it++) {
 		const std::string& arg = *it;
-		if (arg == "-h" || arg == "--help")
+		if (arg == "-h" || arg == "--help") {
 			print_help();
+			Help = true;
+		}
 		else if (arg == "-d" || arg == "--debug") {
 			Debug = true;
 		}
@@ -169,12 +183,27 @@ void PixiConfig::parse_cmd_line_args(const std::vector<std::string>& vargv)
 		else if (arg == "-d255spl") {
 			disable255Sprites = true;
 		}
+		else if (arg == "-fastrom") {
+			FastRom = true;
+		}
+		else if (arg == "-planar") {
+			PlanarPointers = true;
+		}
+		else if (arg == "-cost") {
+			CostReport = true;
+		}
 		else if (arg == "-w") {
 			Warnings = true;
 		}
 		else if (arg == "-ext-off") {
 			ExtMod = false;
 		}
+		else if (arg == "-ips") {
+			Output = RomOutput::Ips;
+		}
+		else if (arg == "-bps") {
+			Output = RomOutput::Bps;
+		}
 		else if (arg == "-meimei-a") {
 			m_meimei.always = true;
 		}
@@ -230,16 +259,23 @@ bool PixiConfig::areConfigFlagsToggled() {
 	return PerLevel || disable255Sprites || true;
 }
 
-void PixiConfig::create_config_file(MemoryFile& config)
+std::array<uint8_t, 4> PixiConfig::version_flags() const {
+	uint8_t flags = (PerLevel ? FLAG_PER_LEVEL : 0) | (PlanarPointers ? FLAG_PLANAR : 0);
+	return { VERSION, flags, 0x00, 0x00 };
+}
+
+void PixiConfig::create_config_file(MemoryFile& config, bool fastrom)
 {
 	config.SetPath(AsmDirPath + "/config.asm");
 	if (areConfigFlagsToggled()) {
 		config.insertString("!PerLevel = {:d}\n", (int)PerLevel);
-		config.insertString("!Disable255SpritesPerLevel = {:d}", (int)disable255Sprites);
+		config.insertString("!Disable255SpritesPerLevel = {:d}\n", (int)disable255Sprites);
+		config.insertString("!FastROM = {:d}\n", (int)fastrom);
+		config.insertString("!PlanarPointers = {:d}", (int)PlanarPointers);
 	}
 }
 
-void PixiConfig::create_shared_patch(MemoryFile& shared)
+void PixiConfig::create_shared_patch(MemoryFile& shared, const std::vector<SharedRoutine>& routines, const std::set<std::string>& used)
 {
 	const std::string& routinepath = m_Paths[PathType::Routines];
 	std::string escapedRoutinepath = escapeDefines(routinepath, R"(\\\!)");
@@ -250,6 +286,7 @@ void PixiConfig::create_shared_patch(MemoryFile& shared)
 		"		pushpc\n"
 		"		if read3(<offset>+$03E05C) != $FFFFFF\n"
 		"			<routine_name> = read3(<offset>+$03E05C)\n"
+		"			print \"    Routine: <routine_name> reused at $\",hex(<routine_name>)\n"
 		"		else\n"
 		"			freecode cleaned\n"
 		"				global #<routine_name>:\n"
@@ -258,38 +295,54 @@ void PixiConfig::create_shared_patch(MemoryFile& shared)
 		"				incsrc \"<path>\"\n"
 		"				namespace off\n"
 		"			ORG <offset>+$03E05C\n"
-		"				dl <routine_name>\n"
+		"				dl <routine_name>|(!FastROM*$800000)\n"
 		"		endif\n"
 		"		pullpc\n"
 		"	endif\n"
 		"endmacro\n");
-	int routine_count = 0;
-	if (!std::filesystem::exists(cleanPathTrail(m_Paths[PathType::Routines]))) {
+	// only the routines that the sprites call get a macro, every sprite's assembly goes through this file
+	std::vector<std::string_view> unused{};
+	for (const SharedRoutine& routine : routines) {
+		if (!used.count(routine.name)) {
+			unused.push_back(routine.name);
+			continue;
+		}
+		shared.insertString(
+			"macro {0}()\n"
+			"\t%include_once(\"{1}{0}.asm\", {0}, ${2:02X})\n"
+			"\tJSL {0}|(!FastROM*$800000)\n"
+			"endmacro\n",
+			routine.name, escapedRoutinepath, routine.slot * 3
+		);
+	}
+	fmt::print("{} Shared routines registered in \"{}\", {} of them used by the sprites\n", routines.size(), routinepath,
+		routines.size() - unused.size());
+	if (Debug && !unused.empty())
+		fmt::print("Unused routines: {}\n", fmt::join(unused, ", "));
+}
+
+std::vector<std::string> PixiConfig::list_routines() const
+{
+	const std::string& routinepath = m_Paths[PathType::Routines];
+	std::vector<std::string> routines{};
+	if (!std::filesystem::exists(cleanPathTrail(routinepath))) {
 		ErrorState::pixi_error("Couldn't open folder \"{}\" for reading.", routinepath);
 	}
 	try {
 		for (const auto& routine_file : std::filesystem::directory_iterator(routinepath)) {
 			std::string name(routine_file.path().filename().generic_string());
-			if (routine_count > DEFAULT_ROUTINES) {
-				ErrorState::pixi_error("More than 100 routines located. Please remove some. \n");
-			}
-			if (nameEndWithAsmExtension(name)) {
-				name = name.substr(0, name.length() - 4);
-				shared.insertString(
-					"macro {0}()\n"
-					"\t%include_once(\"{1}{0}.asm\", {0}, ${2:02X})\n"
-					"\tJSL {0}\n"
-					"endmacro\n",
-					name, escapedRoutinepath, routine_count * 3
-				);
-				routine_count++;
-			}
+			if (nameEndWithAsmExtension(name))
+				routines.push_back(name);
 		}
 	}
 	catch (const std::filesystem::filesystem_error& err) {
 		ErrorState::pixi_error("Trying to read folder \"{}\" returned \"{}\", aborting insertion\n", routinepath, err.what());
 	}
-	fmt::print("{} Shared routines registered in \"{}\"\n", routine_count, routinepath);
+	if ((int)routines.size() > Routines) {
+		ErrorState::pixi_error("More than {} routines located. Please remove some or raise the limit with -nr (maximum {}).\n",
+			Routines, MAX_ROUTINES);
+	}
+	return routines;
 }
 
 void PixiConfig::create_lm_restore()
@@ -340,11 +393,10 @@ void PixiConfig::emit_warnings() {
 			ErrorState::pixi_warning("{}\n", warning);
 		}
 		ErrorState::pixi_warning("Do you want to continue insertion anyway? [Y/n] (Default is yes):\n");
-		char c = (char)getchar();
+		char c = ErrorState::read_answer();
 		if (tolower(c) == 'y') {
 			ErrorState::pixi_error("Insertion was stopped, press any button to exit...\n");
 		}
-		fflush(stdin);
 	}
 }
 
@@ -360,6 +412,9 @@ void PixiConfig::print_help()
 	fmt::print("-npl\t\tSame as the current default, no sprite per level will be inserted, left dangling for "
 		"compatibility reasons\n");
 	fmt::print("-d255spl\t\tDisable 255 sprite per level support (won't do the 1938 remap)\n");
+	fmt::print("-fastrom\tPoint to the sprites and routines through the FastROM banks ($80+), only on LoROM roms with the FastROM bit set in the header\n");
+	fmt::print("-planar\t\tStore the cluster, extended and custom status pointer tables as separate low, high and bank byte arrays\n");
+	fmt::print("-cost\t\tWrite <romname>.cost.json with the bytes, banks and straight-line cycle estimates of every inserted sprite and routine\n");
 	fmt::print("-w\t\tEnable asar warnings check, recommended to use when developing sprites.\n");
 	fmt::print("\n");
 
@@ -395,12 +450,31 @@ void PixiConfig::print_help()
 	fmt::print("-lm-handle <lm_handle_code>\t To be used only within LM's custom user toolbar file, it receives "
 		"LM's handle to reload the rom\n");
 #endif
+	fmt::print("-ips\t\t Leaves the ROM untouched and writes the changes to <romname>.ips instead\n");
+	fmt::print("-bps\t\t Leaves the ROM untouched and writes the changes to <romname>.bps instead\n");
 	fmt::print("-no-config\t Disables the use of the config file for this run\n");
+#ifndef WIN32
+	fmt::print("--serve [--socket <path>]\tStarts a resident server that keeps asar loaded and serves insertions "
+		"sent by --client, must be the first option (Default socket {})\n", ServerRequest::DEFAULT_SOCKET);
+	fmt::print("--client [--socket <path>] <options> <ROM>\tSends the insertion to a running server instead of doing it "
+		"in this process, must be the first option\n");
+#endif
+#ifdef __linux__
+	fmt::print("--watch <options> <ROM>\tInserts, then inserts again every time the list, sprites, routines, asm files "
+		"or pixi_conf.toml change, must be the first option\n");
+#endif
+	fmt::print("--batch [-j <jobs>] <options> -- <ROM> <ROM>...\tInserts into every ROM, the list and the sprites are parsed "
+		"only once, up to <jobs> ROMs at the same time, must be the first option\n");
+	fmt::print("--batch [-j <jobs>] <options> --manifest <file>\tSame, but the ROMs are read from <file>, one per line\n");
+	fmt::print("--bench [-v] [-clock auto|s-cpu|sa1] <ROM>\tRuns the hijacks PIXI inserted on a 65816 interpreter for every custom "
+		"sprite and reports the cycles and master clocks per call, -v lists every call, -clock picks the timings of the S-CPU or "
+		"the SA-1 (auto: the cpu the sprites run on), must be the first option\n");
+	fmt::print("\nA run is skipped when the ROM and every input are the same as after the previous one, "
+		"delete <romname>.pixi to force it\n");
 
 	fmt::print("\nMeiMei flags:\n");
 	fmt::print("-meimei-off\t\tShuts down MeiMei completely\n");
 	fmt::print("-meimei-a\t\tEnables always remap sprite data\n");
 	fmt::print("-meimei-k\t\tEnables keep temp patches files\n");
 	fmt::print("-meimei-d\t\tEnables debug for MeiMei patches\n\n");
-	exit(0);
 }
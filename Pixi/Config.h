@@ -3,6 +3,7 @@
 #include <array>
 #include <string>
 #include <fstream>
+#include <set>
 #include "StructParams.h"
 #include "toml/toml.hpp"
 
@@ -21,6 +22,9 @@ enum class PathType : int {
 
 enum class ExtType : int { Ssc, Mwt, Mw2, S16, SIZE };
 
+// what gets written at the end of the insertion: the rom itself or a patch against the original rom
+enum class RomOutput : int { Rom, Ips, Bps };
+
 struct MeiMeiConfig {
 	bool always = false;
 	bool debug = false;
@@ -111,12 +115,19 @@ struct Extensions {
 	};
 };
 
+// files that pixi itself writes in the asm folder while inserting (config.asm, shared.asm, _*.bin, ...)
+bool is_generated_file(std::string_view name);
+
+struct SharedRoutine;
+
 struct PixiConfig {
 	static constexpr char TEMP_SPR_FILE[13] = "spr_temp.asm";
 	static constexpr int VERSION = 0x32;
 	static constexpr int DEFAULT_ROUTINES = 100;
 	static constexpr int MAX_ROUTINES = 310;
-	inline static const ByteArray<uint8_t, 4> versionflag { VERSION, 0x00, 0x00, 0x00 };
+	// flags of the byte after the version at $02FFE7, what clean needs to know about the last insertion
+	static constexpr uint8_t FLAG_PER_LEVEL = 0x01;
+	static constexpr uint8_t FLAG_PLANAR = 0x02;
 	using Iter = std::vector<std::string>::const_iterator;
 	PixiConfig() = default;
 	PixiConfig(int argc, char* argv[]);
@@ -126,11 +137,20 @@ struct PixiConfig {
 	bool KeepFiles = false;
 	bool PerLevel = false;
 	bool disable255Sprites = false;
+	// sprite and routine pointers go through the $80+ banks, only for FastROM LoROM roms
+	bool FastRom = false;
+	// pointer tables as separate low, high and bank byte arrays, so the dispatch doesn't have to multiply by 3
+	bool PlanarPointers = false;
+	// writes <romname>.cost.json with the size, banks and cycle estimates of what was inserted, see Cost.h
+	bool CostReport = false;
 	bool ExtMod = true;
 	bool DisableMeiMei = false;
 	bool Warnings = false;
 	bool Debug = false;
+	// -h was given, the help was printed instead of inserting anything
+	bool Help = false;
 	int Routines = 100;
+	RomOutput Output = RomOutput::Rom;
 	std::vector<std::string> WarningList{};
 	std::string PixiExe{};
 	std::string RomName{};
@@ -151,8 +171,13 @@ struct PixiConfig {
 	void parse_cmd_line_args(const std::vector<std::string>& vargv);
 	void correct_paths();
 	bool areConfigFlagsToggled();
-	void create_config_file(MemoryFile& config);
-	void create_shared_patch(MemoryFile& shared);
+	// version number, flags and the 2 reserved bytes, as stored at $02FFE6
+	std::array<uint8_t, 4> version_flags() const;
+	void create_config_file(MemoryFile& config, bool fastrom);
+	// registers the routines in used, the slot of each routine is its index in the routines folder
+	void create_shared_patch(MemoryFile& shared, const std::vector<SharedRoutine>& routines, const std::set<std::string>& used);
+	// file names of the shared routines, in the order of their slots in the pointer table
+	std::vector<std::string> list_routines() const;
 	void create_lm_restore();
 	std::vector<std::string> list_extra_asm(const char* folder);
 	void emit_warnings();
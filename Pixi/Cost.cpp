@@ -0,0 +1,161 @@
+#include "Cost.h"
+#include "Cpu65816.h"
+#include "json/json.hpp"
+
+// what ends a straight line: branches, jumps, calls and returns, block moves (they loop) and what leaves the flags unknown
+static bool ends_straight_line(uint8_t opcode) {
+	switch (opcode) {
+	case 0x10: case 0x30: case 0x50: case 0x70: case 0x90: case 0xB0: case 0xD0: case 0xF0: case 0x80: case 0x82:
+	case 0x4C: case 0x5C: case 0x6C: case 0x7C: case 0xDC:
+	case 0x20: case 0x22: case 0xFC:
+	case 0x60: case 0x6B: case 0x40:
+	case 0x44: case 0x54:
+	case 0x28: case 0xFB:
+	case 0x00: case 0x02: case 0xCB: case 0xDB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static std::string_view speed(const SnesBus& bus, uint32_t address) {
+	if (bus.sa1_clock())
+		return "sa1";
+	return (address & 0x800000) && bus.fastrom() ? "fast" : "slow";
+}
+
+static nlohmann::json straight_line(SnesBus& bus, uint32_t address) {
+	bus.clear();
+	Cpu65816 cpu{ bus };
+	cpu.always_cross_pages = true;
+	cpu.d = bus.dp();
+	cpu.db = address >> 16;
+	cpu.pb = address >> 16;
+	cpu.pc = address & 0xFFFF;
+	int instructions = 0;
+	while (instructions < 0x10000 && !ends_straight_line(bus.read(cpu.address()))) {
+		cpu.step();
+		if (cpu.halted())
+			break;
+		instructions++;
+	}
+	return {
+		{ "instructions", instructions },
+		{ "bytes", static_cast<uint16_t>(cpu.pc - address) },
+		{ "cycles", cpu.cycles },
+		{ "master_clocks", cpu.clocks },
+		{ "ends_at", cpu.address() },
+		{ "ends_with", bus.read(cpu.address()) }
+	};
+}
+
+static nlohmann::json entry_point(SnesBus& bus, const Pointer& pointer) {
+	uint32_t address = static_cast<uint32_t>(pointer.addr());
+	return {
+		{ "address", address },
+		{ "bank", pointer.bankbyte },
+		{ "speed", speed(bus, address) },
+		{ "straight_line", straight_line(bus, address) }
+	};
+}
+
+// size of the data a RATS tag right before address protects, 0 if there's no tag
+static int rats_size(SnesBus& bus, uint32_t address) {
+	uint32_t tag = (address & 0x7FFFFF) - 8;
+	if (bus.read(tag) != 'S' || bus.read(tag + 1) != 'T' || bus.read(tag + 2) != 'A' || bus.read(tag + 3) != 'R')
+		return 0;
+	int size = bus.read(tag + 4) | (bus.read(tag + 5) << 8);
+	int inverse = bus.read(tag + 6) | (bus.read(tag + 7) << 8);
+	if ((size ^ inverse) != 0xFFFF)
+		return 0;
+	return size + 1;
+}
+
+void write_cost_report(PixiConfig& cfg, Rom& rom, SpritesData& sprdata) {
+	SnesBus bus{ rom };
+
+	// the routines a sprite inserted are reported on their own, and their blocks left out of the sprite's
+	std::vector<uint32_t> routine_entries{};
+	nlohmann::json routines = nlohmann::json::array();
+	for (const SharedRoutine& routine : rom.shared_routines()) {
+		int pointer = rom.routine_pointer(routine.slot);
+		if (pointer == 0xFFFFFF)
+			continue;
+		routine_entries.push_back(pointer & 0x7FFFFF);
+		int bytes = rats_size(bus, pointer);
+		nlohmann::json entry = entry_point(bus, Pointer(pointer));
+		entry["name"] = routine.name;
+		entry["slot"] = routine.slot;
+		entry["bytes"] = bytes == 0 ? nlohmann::json{} : nlohmann::json(bytes);
+		routines.push_back(entry);
+	}
+	auto block_kind = [&routine_entries](const WrittenBlock& block) -> std::string_view {
+		int end = Rom::ROUTINE_POINTERS + Rom::ROUTINE_SLOTS * 3;
+		if (block.snes < end && block.snes + block.size > Rom::ROUTINE_POINTERS)
+			return "routine_pointer";
+		for (uint32_t entry : routine_entries) {
+			if (entry >= static_cast<uint32_t>(block.snes) && entry < static_cast<uint32_t>(block.snes + block.size))
+				return "routine";
+		}
+		return "sprite";
+	};
+
+	// sprites that use the same asm file share its blocks, they're reported with the first one and the others point to it
+	std::map<std::string, nlohmann::json> block_owners{};
+	const std::vector<WrittenBlock> no_blocks{};
+	nlohmann::json sprites = nlohmann::json::array();
+	constexpr std::array<std::pair<ListType, std::string_view>, 3> lists{ {
+		{ ListType::Sprite, "sprite" }, { ListType::Cluster, "cluster" }, { ListType::Extended, "extended" }
+	} };
+	for (const auto& [type, list] : lists) {
+		for (const Sprite& spr : sprdata[type].sprites) {
+			if (spr.asm_file.empty() || spr.table == nullptr)
+				continue;
+			nlohmann::json level = spr.level == 0x200 ? nlohmann::json{} : nlohmann::json(spr.level);
+			auto [owner, first] = block_owners.try_emplace(spr.asm_file, nlohmann::json{ { "list", list }, { "number", spr.number }, { "level", level } });
+			int bytes = 0;
+			nlohmann::json blocks = nlohmann::json::array();
+			for (const WrittenBlock& block : first ? rom.sprite_blocks(spr.asm_file) : no_blocks) {
+				std::string_view kind = block_kind(block);
+				if (kind == "sprite")
+					bytes += block.size;
+				blocks.push_back({
+					{ "snes", block.snes },
+					{ "pc", block.pc },
+					{ "size", block.size },
+					{ "bank", block.snes >> 16 },
+					{ "kind", kind }
+				});
+			}
+			nlohmann::json entry = {
+				{ "list", list },
+				{ "number", spr.number },
+				{ "level", level },
+				{ "file", spr.asm_file },
+				{ "bytes", bytes },
+				{ "blocks", blocks }
+			};
+			if (!first)
+				entry["shared_with"] = owner->second;
+			if (!spr.table->init.is_empty())
+				entry["init"] = entry_point(bus, spr.table->init);
+			if (!spr.table->main.is_empty())
+				entry["main"] = entry_point(bus, spr.table->main);
+			sprites.push_back(entry);
+		}
+	}
+
+	nlohmann::json report = {
+		{ "rom", cfg.RomName },
+		{ "mapper", MapperToString(rom.mapper()) },
+		{ "cpu", bus.sa1_clock() ? "sa1" : "s-cpu" },
+		{ "fastrom_header", bus.fastrom() },
+		{ "sprites", sprites },
+		{ "routines", routines }
+	};
+	std::string text = report.dump(1, '\t') + "\n";
+	FILE* fp = open_subfile(cfg.RomName, "cost.json", "w");
+	fwrite(text.data(), 1, text.size(), fp);
+	fclose(fp);
+	fmt::print("Cost report written to {}\n", subfile_name(cfg.RomName, "cost.json"));
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#pragma once
+#include "SpritesData.h"
+
+// -cost: writes <romname>.cost.json once everything is inserted, before the rom is written
+// for every listed sprite the blocks its patch wrote (without the shared routines it inserted), and for its INIT and MAIN and every
+// shared routine in the rom the bank, the speed it runs at and a worst case estimate of the code up to the first branch, jump, call
+// or return, run with Cpu65816 from the 8-bit M/X state sprites are called with, counting every index page crossing.
+void write_cost_report(PixiConfig& cfg, Rom& rom, SpritesData& sprdata);
\ No newline at end of file
@@ -0,0 +1,800 @@
+#include "Cpu65816.h"
+#include "Rom.h"
+
+SnesBus::SnesBus(Rom& rom, BusClock clock) : m_rom(rom), m_sa1(rom.mapper() != MapperType::LoRom) {
+	m_sa1_clock = clock == BusClock::Auto ? m_sa1 : clock == BusClock::Sa1;
+	m_fastrom = !m_sa1 && (rom.data()[0x7FD5] & 0x10) != 0;
+}
+
+uint8_t* SnesBus::memory(uint32_t address) {
+	uint8_t bank = address >> 16;
+	uint16_t offset = address & 0xFFFF;
+	bool system = (bank & 0x40) == 0;
+	if (m_sa1) {
+		if (system && offset < 0x0800)
+			return &m_iram[offset];
+		if (system && offset >= 0x3000 && offset < 0x3800)
+			return &m_iram[offset - 0x3000];
+		if (system && offset >= 0x6000 && offset < 0x8000)
+			return &m_bwram[offset - 0x6000];
+		if (bank >= 0x40 && bank < 0x44)
+			return &m_bwram[address & 0x3FFFF];
+		return nullptr;
+	}
+	if ((bank & 0xFE) == 0x7E)
+		return &m_wram[address & 0x1FFFF];
+	if (system && offset < 0x2000)
+		return &m_wram[offset];
+	return nullptr;
+}
+
+void SnesBus::clear() {
+	std::fill(m_wram.begin(), m_wram.end(), 0);
+	std::fill(m_iram.begin(), m_iram.end(), 0);
+	std::fill(m_bwram.begin(), m_bwram.end(), 0);
+}
+
+uint8_t SnesBus::read(uint32_t address) {
+	if (uint8_t* ram = memory(address))
+		return *ram;
+	size_t pc = m_rom.snes_to_pc(address, false);
+	if (pc >= static_cast<size_t>(m_rom.size()))
+		return 0;
+	return m_rom.read_byte(pc);
+}
+
+void SnesBus::write(uint32_t address, uint8_t value) {
+	if (uint8_t* ram = memory(address))
+		*ram = value;
+}
+
+uint32_t SnesBus::read_long(uint32_t address) {
+	return read(address) | (read(address + 1) << 8) | (read(address + 2) << 16);
+}
+
+int SnesBus::clocks(uint32_t address) {
+	uint8_t bank = address >> 16;
+	uint16_t offset = address & 0xFFFF;
+	if (m_sa1_clock) {
+		// BW-RAM takes the SA-1 a cycle more
+		bool bwram = ((bank & 0x40) == 0 && offset >= 0x6000 && offset < 0x8000) || (bank >= 0x40 && bank < 0x60);
+		return bwram ? 4 : 2;
+	}
+	bool fast = (bank & 0x80) && m_fastrom;
+	if ((bank & 0x40) == 0) {
+		if (offset < 0x2000)
+			return 8;
+		if (offset < 0x4000)
+			return 6;
+		if (offset < 0x4200)
+			return 12;
+		if (offset < 0x6000)
+			return 6;
+		if (offset < 0x8000)
+			return 8;
+	}
+	return fast ? 6 : 8;
+}
+
+int SnesBus::io_clocks() {
+	return m_sa1_clock ? 2 : 6;
+}
+
+void Cpu65816::io(int count) {
+	cycles += count;
+	clocks += static_cast<uint64_t>(count) * m_bus.io_clocks();
+}
+
+uint8_t Cpu65816::read8(uint32_t address) {
+	address &= 0xFFFFFF;
+	cycles++;
+	clocks += m_bus.clocks(address);
+	return m_bus.read(address);
+}
+
+void Cpu65816::write8(uint32_t address, uint8_t value) {
+	address &= 0xFFFFFF;
+	cycles++;
+	clocks += m_bus.clocks(address);
+	m_bus.write(address, value);
+}
+
+uint8_t Cpu65816::fetch8() {
+	uint8_t value = read8(address());
+	pc++;
+	return value;
+}
+
+uint16_t Cpu65816::fetch16() {
+	uint16_t value = fetch8();
+	return value | (fetch8() << 8);
+}
+
+uint32_t Cpu65816::fetch24() {
+	uint32_t value = fetch16();
+	return value | (fetch8() << 16);
+}
+
+void Cpu65816::push8(uint8_t value) {
+	write8(s, value);
+	s--;
+}
+
+uint8_t Cpu65816::pull8() {
+	s++;
+	return read8(s);
+}
+
+void Cpu65816::push16(uint16_t value) {
+	push8(value >> 8);
+	push8(value & 0xFF);
+}
+
+uint16_t Cpu65816::pull16() {
+	uint16_t value = pull8();
+	return value | (pull8() << 8);
+}
+
+void Cpu65816::set_p(uint8_t value) {
+	p = value;
+	if (x8()) {
+		x &= 0xFF;
+		y &= 0xFF;
+	}
+}
+
+uint32_t Cpu65816::next(const Operand& op) const {
+	if (op.bank0)
+		return (op.address + 1) & 0xFFFF;
+	return (op.address + 1) & 0xFFFFFF;
+}
+
+uint16_t Cpu65816::load(const Operand& op, bool wide) {
+	uint16_t value = read8(op.address);
+	if (wide)
+		value |= read8(next(op)) << 8;
+	return value;
+}
+
+void Cpu65816::store(const Operand& op, uint16_t value, bool wide) {
+	write8(op.address, value & 0xFF);
+	if (wide)
+		write8(next(op), value >> 8);
+}
+
+uint16_t Cpu65816::dp_pointer(uint16_t address) {
+	uint16_t value = read8(address);
+	return value | (read8(static_cast<uint16_t>(address + 1)) << 8);
+}
+
+Cpu65816::Operand Cpu65816::operand(Mode mode, bool write) {
+	// the direct page modes take a cycle more when the direct page isn't page aligned
+	auto direct = [this](uint8_t offset) -> uint16_t {
+		if (d & 0xFF)
+			io();
+		return static_cast<uint16_t>(d + offset);
+	};
+	// indexed modes crossing a page (or using 16 bit indexes) take a cycle more, stores always do
+	auto indexed = [this, write](uint32_t base, uint16_t index) -> uint32_t {
+		uint32_t address = (base + index) & 0xFFFFFF;
+		if (write || !x8() || always_cross_pages || (base & 0xFF00) != (address & 0xFF00))
+			io();
+		return address;
+	};
+	switch (mode) {
+	case Mode::Dp:
+		return { direct(fetch8()), true };
+	case Mode::DpX: {
+		uint16_t address = direct(fetch8());
+		io();
+		return { static_cast<uint16_t>(address + x), true };
+	}
+	case Mode::DpY: {
+		uint16_t address = direct(fetch8());
+		io();
+		return { static_cast<uint16_t>(address + y), true };
+	}
+	case Mode::DpInd: {
+		uint16_t pointer = dp_pointer(direct(fetch8()));
+		return { static_cast<uint32_t>((db << 16) | pointer), false };
+	}
+	case Mode::DpIndLong: {
+		uint16_t address = direct(fetch8());
+		uint32_t pointer = dp_pointer(address);
+		pointer |= read8(static_cast<uint16_t>(address + 2)) << 16;
+		return { pointer, false };
+	}
+	case Mode::DpXInd: {
+		uint16_t address = direct(fetch8());
+		io();
+		uint16_t pointer = dp_pointer(static_cast<uint16_t>(address + x));
+		return { static_cast<uint32_t>((db << 16) | pointer), false };
+	}
+	case Mode::DpIndY: {
+		uint16_t pointer = dp_pointer(direct(fetch8()));
+		return { indexed((db << 16) | pointer, y), false };
+	}
+	case Mode::DpIndLongY: {
+		uint16_t address = direct(fetch8());
+		uint32_t pointer = dp_pointer(address);
+		pointer |= read8(static_cast<uint16_t>(address + 2)) << 16;
+		return { (pointer + y) & 0xFFFFFF, false };
+	}
+	case Mode::Abs:
+		return { static_cast<uint32_t>((db << 16) | fetch16()), false };
+	case Mode::AbsX:
+		return { indexed((db << 16) | fetch16(), x), false };
+	case Mode::AbsY:
+		return { indexed((db << 16) | fetch16(), y), false };
+	case Mode::Long:
+		return { fetch24(), false };
+	case Mode::LongX:
+		return { (fetch24() + x) & 0xFFFFFF, false };
+	case Mode::Sr: {
+		uint8_t offset = fetch8();
+		io();
+		return { static_cast<uint16_t>(s + offset), true };
+	}
+	case Mode::SrIndY: {
+		uint8_t offset = fetch8();
+		io();
+		uint16_t pointer = dp_pointer(static_cast<uint16_t>(s + offset));
+		io();
+		return { static_cast<uint32_t>(((db << 16) + pointer + y) & 0xFFFFFF), false };
+	}
+	}
+	return { 0, false };
+}
+
+uint16_t Cpu65816::immediate(bool wide) {
+	return wide ? fetch16() : fetch8();
+}
+
+void Cpu65816::set_nz(uint16_t value, bool wide) {
+	uint16_t sign = wide ? 0x8000 : 0x80;
+	uint16_t mask = wide ? 0xFFFF : 0xFF;
+	p &= ~(N | Z);
+	if ((value & mask) == 0)
+		p |= Z;
+	if (value & sign)
+		p |= N;
+}
+
+// binary or decimal, a nibble at a time like the real alu so the flags come out the same with invalid bcd too
+uint16_t Cpu65816::adc(uint16_t value, bool wide, bool subtract) {
+	int nibbles = wide ? 4 : 2;
+	int mask = wide ? 0xFFFF : 0xFF;
+	int sign = wide ? 0x8000 : 0x80;
+	int lhs = a & mask;
+	int rhs = subtract ? (~value & mask) : (value & mask);
+	int carry = p & C;
+	int result;
+	if (!(p & D)) {
+		result = lhs + rhs + carry;
+	} else {
+		result = 0;
+		for (int i = 0; i < nibbles; i++) {
+			int shift = 4 * i;
+			int nibble = 0xF << shift;
+			int below = (1 << shift) - 1;
+			result = (lhs & nibble) + (rhs & nibble) + (carry << shift) + (result & below);
+			if (i == nibbles - 1)
+				break;
+			if (!subtract && result > (0xA << shift) - 1)
+				result += 0x6 << shift;
+			else if (subtract && result <= (0x10 << shift) - 1)
+				result -= 0x6 << shift;
+			carry = result > (0x10 << shift) - 1;
+		}
+	}
+	p &= ~(V | C);
+	if (~(lhs ^ rhs) & (lhs ^ result) & sign)
+		p |= V;
+	if (p & D) {
+		int top = 4 * (nibbles - 1);
+		if (!subtract && result > (0xA << top) - 1)
+			result += 0x6 << top;
+		else if (subtract && result <= mask)
+			result -= 0x6 << top;
+	}
+	if (result > mask)
+		p |= C;
+	set_nz(static_cast<uint16_t>(result), wide);
+	return static_cast<uint16_t>(result & mask);
+}
+
+void Cpu65816::compare(uint16_t reg, uint16_t value, bool wide) {
+	uint16_t mask = wide ? 0xFFFF : 0xFF;
+	reg &= mask;
+	value &= mask;
+	p &= ~C;
+	if (reg >= value)
+		p |= C;
+	set_nz(static_cast<uint16_t>(reg - value), wide);
+}
+
+// kind is the row of the shift in the opcode map: ASL, ROL, LSR, ROR
+uint16_t Cpu65816::shift(int kind, uint16_t value, bool wide) {
+	uint16_t sign = wide ? 0x8000 : 0x80;
+	uint16_t mask = wide ? 0xFFFF : 0xFF;
+	uint16_t carry_in = p & C;
+	uint16_t result;
+	p &= ~C;
+	switch (kind) {
+	case 0:
+		if (value & sign)
+			p |= C;
+		result = value << 1;
+		break;
+	case 1:
+		if (value & sign)
+			p |= C;
+		result = (value << 1) | carry_in;
+		break;
+	case 2:
+		if (value & 1)
+			p |= C;
+		result = (value & mask) >> 1;
+		break;
+	default:
+		if (value & 1)
+			p |= C;
+		result = ((value & mask) >> 1) | (carry_in ? sign : 0);
+		break;
+	}
+	result &= mask;
+	set_nz(result, wide);
+	return result;
+}
+
+// group is the row of the instruction in the opcode map: ORA, AND, EOR, ADC, (STA), LDA, CMP, SBC
+void Cpu65816::accumulator_op(int group, uint16_t value) {
+	bool wide = !m8();
+	uint16_t result = a;
+	switch (group) {
+	case 0:
+		result = a | value;
+		break;
+	case 1:
+		result = a & value;
+		break;
+	case 2:
+		result = a ^ value;
+		break;
+	case 3:
+		result = adc(value, wide, false);
+		break;
+	case 5:
+		result = value;
+		break;
+	case 6:
+		compare(a, value, wide);
+		return;
+	case 7:
+		result = adc(value, wide, true);
+		break;
+	}
+	if (group != 3 && group != 7)
+		set_nz(result, wide);
+	a = wide ? result : ((a & 0xFF00) | (result & 0xFF));
+}
+
+// kind: 0-3 the shifts, 4 DEC, 5 INC, 6 TSB, 7 TRB
+void Cpu65816::modify(int kind, Mode mode) {
+	bool wide = !m8();
+	uint16_t mask = wide ? 0xFFFF : 0xFF;
+	Operand op = operand(mode, true);
+	uint16_t value = load(op, wide);
+	io();
+	uint16_t result;
+	switch (kind) {
+	case 4:
+		result = (value - 1) & mask;
+		set_nz(result, wide);
+		break;
+	case 5:
+		result = (value + 1) & mask;
+		set_nz(result, wide);
+		break;
+	case 6:
+	case 7:
+		p &= ~Z;
+		if ((a & value & mask) == 0)
+			p |= Z;
+		result = kind == 6 ? (value | a) & mask : (value & ~a) & mask;
+		break;
+	default:
+		result = shift(kind, value, wide);
+		break;
+	}
+	// the high byte goes out first
+	if (wide)
+		write8(next(op), result >> 8);
+	write8(op.address, result & 0xFF);
+}
+
+void Cpu65816::branch(bool taken) {
+	int8_t offset = static_cast<int8_t>(fetch8());
+	if (taken) {
+		io();
+		pc = static_cast<uint16_t>(pc + offset);
+	}
+}
+
+void Cpu65816::return_long() {
+	m_jumped_indirect = false;
+	read8(address());
+	io(2);
+	pc = pull16();
+	pb = pull8();
+	pc++;
+}
+
+void Cpu65816::step() {
+	m_jumped_indirect = false;
+	if (halted())
+		return;
+	uint32_t at = address();
+	uint8_t opcode = fetch8();
+
+	// ORA AND EOR ADC STA LDA CMP SBC share their addressing modes by column
+	static constexpr Mode NONE = static_cast<Mode>(-1);
+	static constexpr Mode columns[0x20] = {
+		NONE, Mode::DpXInd, NONE, Mode::Sr, NONE, Mode::Dp, NONE, Mode::DpIndLong,
+		NONE, NONE, NONE, NONE, NONE, Mode::Abs, NONE, Mode::Long,
+		NONE, Mode::DpIndY, Mode::DpInd, Mode::SrIndY, NONE, Mode::DpX, NONE, Mode::DpIndLongY,
+		NONE, Mode::AbsY, NONE, NONE, NONE, Mode::AbsX, NONE, Mode::LongX
+	};
+	int group = opcode >> 5;
+	int column = opcode & 0x1F;
+	if (opcode != 0x89 && (column == 0x09 || columns[column] != NONE)) {
+		bool wide = !m8();
+		if (group == 4) {
+			store(operand(columns[column], true), a, wide);
+		} else {
+			uint16_t value = column == 0x09 ? immediate(wide) : load(operand(columns[column], false), wide);
+			accumulator_op(group, value);
+		}
+		return;
+	}
+
+	auto load_index = [this](uint16_t& reg, uint16_t value) {
+		reg = value;
+		set_nz(value, !x8());
+	};
+	auto transfer_index = [this](uint16_t& dest, uint16_t value) {
+		dest = x8() ? (value & 0xFF) : value;
+		set_nz(dest, !x8());
+	};
+	auto transfer_a = [this](uint16_t value) {
+		a = m8() ? ((a & 0xFF00) | (value & 0xFF)) : value;
+		set_nz(a, !m8());
+	};
+	auto step_index = [this](uint16_t& reg, int delta) {
+		reg = static_cast<uint16_t>(reg + delta);
+		if (x8())
+			reg &= 0xFF;
+		io();
+		set_nz(reg, !x8());
+	};
+	auto step_a = [this, &transfer_a](int delta) {
+		uint16_t result = static_cast<uint16_t>(a + delta);
+		io();
+		transfer_a(result);
+	};
+	auto shift_a = [this](int kind) {
+		io();
+		uint16_t result = shift(kind, a, !m8());
+		a = m8() ? ((a & 0xFF00) | result) : result;
+	};
+	auto bit = [this](uint16_t value, bool immediate) {
+		bool wide = !m8();
+		uint16_t mask = wide ? 0xFFFF : 0xFF;
+		p &= ~Z;
+		if ((a & value & mask) == 0)
+			p |= Z;
+		if (!immediate) {
+			p &= ~(N | V);
+			if (value & (wide ? 0x8000 : 0x80))
+				p |= N;
+			if (value & (wide ? 0x4000 : 0x40))
+				p |= V;
+		}
+	};
+	auto push_reg = [this](uint16_t value, bool wide) {
+		io();
+		if (wide)
+			push16(value);
+		else
+			push8(value & 0xFF);
+	};
+	auto pull_reg = [this](bool wide) -> uint16_t {
+		io(2);
+		uint16_t value = wide ? pull16() : pull8();
+		set_nz(value, wide);
+		return value;
+	};
+	auto block_move = [this](int delta) {
+		uint8_t dest = fetch8();
+		uint8_t source = fetch8();
+		db = dest;
+		uint8_t value = read8((source << 16) | x);
+		write8((dest << 16) | y, value);
+		io(2);
+		x = static_cast<uint16_t>(x + delta);
+		y = static_cast<uint16_t>(y + delta);
+		if (x8()) {
+			x &= 0xFF;
+			y &= 0xFF;
+		}
+		// the instruction runs again (opcode and operands fetched every time) until a wraps to $FFFF
+		if (a-- != 0)
+			pc -= 3;
+	};
+
+	switch (opcode) {
+	// shifts, INC, DEC, TSB and TRB
+	case 0x06: modify(0, Mode::Dp); break;
+	case 0x0E: modify(0, Mode::Abs); break;
+	case 0x16: modify(0, Mode::DpX); break;
+	case 0x1E: modify(0, Mode::AbsX); break;
+	case 0x26: modify(1, Mode::Dp); break;
+	case 0x2E: modify(1, Mode::Abs); break;
+	case 0x36: modify(1, Mode::DpX); break;
+	case 0x3E: modify(1, Mode::AbsX); break;
+	case 0x46: modify(2, Mode::Dp); break;
+	case 0x4E: modify(2, Mode::Abs); break;
+	case 0x56: modify(2, Mode::DpX); break;
+	case 0x5E: modify(2, Mode::AbsX); break;
+	case 0x66: modify(3, Mode::Dp); break;
+	case 0x6E: modify(3, Mode::Abs); break;
+	case 0x76: modify(3, Mode::DpX); break;
+	case 0x7E: modify(3, Mode::AbsX); break;
+	case 0xC6: modify(4, Mode::Dp); break;
+	case 0xCE: modify(4, Mode::Abs); break;
+	case 0xD6: modify(4, Mode::DpX); break;
+	case 0xDE: modify(4, Mode::AbsX); break;
+	case 0xE6: modify(5, Mode::Dp); break;
+	case 0xEE: modify(5, Mode::Abs); break;
+	case 0xF6: modify(5, Mode::DpX); break;
+	case 0xFE: modify(5, Mode::AbsX); break;
+	case 0x04: modify(6, Mode::Dp); break;
+	case 0x0C: modify(6, Mode::Abs); break;
+	case 0x14: modify(7, Mode::Dp); break;
+	case 0x1C: modify(7, Mode::Abs); break;
+	case 0x0A: shift_a(0); break;
+	case 0x2A: shift_a(1); break;
+	case 0x4A: shift_a(2); break;
+	case 0x6A: shift_a(3); break;
+	case 0x1A: step_a(1); break;
+	case 0x3A: step_a(-1); break;
+
+	// index registers
+	case 0xA0: load_index(y, immediate(!x8())); break;
+	case 0xA4: load_index(y, load(operand(Mode::Dp, false), !x8())); break;
+	case 0xAC: load_index(y, load(operand(Mode::Abs, false), !x8())); break;
+	case 0xB4: load_index(y, load(operand(Mode::DpX, false), !x8())); break;
+	case 0xBC: load_index(y, load(operand(Mode::AbsX, false), !x8())); break;
+	case 0xA2: load_index(x, immediate(!x8())); break;
+	case 0xA6: load_index(x, load(operand(Mode::Dp, false), !x8())); break;
+	case 0xAE: load_index(x, load(operand(Mode::Abs, false), !x8())); break;
+	case 0xB6: load_index(x, load(operand(Mode::DpY, false), !x8())); break;
+	case 0xBE: load_index(x, load(operand(Mode::AbsY, false), !x8())); break;
+	case 0x84: store(operand(Mode::Dp, true), y, !x8()); break;
+	case 0x8C: store(operand(Mode::Abs, true), y, !x8()); break;
+	case 0x94: store(operand(Mode::DpX, true), y, !x8()); break;
+	case 0x86: store(operand(Mode::Dp, true), x, !x8()); break;
+	case 0x8E: store(operand(Mode::Abs, true), x, !x8()); break;
+	case 0x96: store(operand(Mode::DpY, true), x, !x8()); break;
+	case 0xC0: compare(y, immediate(!x8()), !x8()); break;
+	case 0xC4: compare(y, load(operand(Mode::Dp, false), !x8()), !x8()); break;
+	case 0xCC: compare(y, load(operand(Mode::Abs, false), !x8()), !x8()); break;
+	case 0xE0: compare(x, immediate(!x8()), !x8()); break;
+	case 0xE4: compare(x, load(operand(Mode::Dp, false), !x8()), !x8()); break;
+	case 0xEC: compare(x, load(operand(Mode::Abs, false), !x8()), !x8()); break;
+	case 0x88: step_index(y, -1); break;
+	case 0xC8: step_index(y, 1); break;
+	case 0xCA: step_index(x, -1); break;
+	case 0xE8: step_index(x, 1); break;
+
+	// STZ and BIT
+	case 0x64: store(operand(Mode::Dp, true), 0, !m8()); break;
+	case 0x74: store(operand(Mode::DpX, true), 0, !m8()); break;
+	case 0x9C: store(operand(Mode::Abs, true), 0, !m8()); break;
+	case 0x9E: store(operand(Mode::AbsX, true), 0, !m8()); break;
+	case 0x89: bit(immediate(!m8()), true); break;
+	case 0x24: bit(load(operand(Mode::Dp, false), !m8()), false); break;
+	case 0x2C: bit(load(operand(Mode::Abs, false), !m8()), false); break;
+	case 0x34: bit(load(operand(Mode::DpX, false), !m8()), false); break;
+	case 0x3C: bit(load(operand(Mode::AbsX, false), !m8()), false); break;
+
+	// transfers
+	case 0xAA: io(); transfer_index(x, a); break;
+	case 0xA8: io(); transfer_index(y, a); break;
+	case 0xBA: io(); transfer_index(x, s); break;
+	case 0x9B: io(); transfer_index(y, x); break;
+	case 0xBB: io(); transfer_index(x, y); break;
+	case 0x8A: io(); transfer_a(x); break;
+	case 0x98: io(); transfer_a(y); break;
+	case 0x9A: io(); s = x; break;
+	case 0x1B: io(); s = a; break;
+	case 0x3B: io(); a = s; set_nz(a, true); break;
+	case 0x5B: io(); d = a; set_nz(d, true); break;
+	case 0x7B: io(); a = d; set_nz(a, true); break;
+	case 0xEB:
+		io(2);
+		a = static_cast<uint16_t>((a >> 8) | (a << 8));
+		set_nz(a, false);
+		break;
+
+	// flags
+	case 0x18: io(); p &= ~C; break;
+	case 0x38: io(); p |= C; break;
+	case 0x58: io(); p &= ~I; break;
+	case 0x78: io(); p |= I; break;
+	case 0xB8: io(); p &= ~V; break;
+	case 0xD8: io(); p &= ~D; break;
+	case 0xF8: io(); p |= D; break;
+	case 0xC2: {
+		uint8_t value = fetch8();
+		io();
+		set_p(p & ~value);
+		break;
+	}
+	case 0xE2: {
+		uint8_t value = fetch8();
+		io();
+		set_p(p | value);
+		break;
+	}
+	case 0xFB:
+		io();
+		if (p & C)
+			m_halt = fmt::format("XCE into emulation mode at ${:06X}", at);
+		else
+			p &= ~C;
+		break;
+
+	// stack
+	case 0x48: push_reg(a, !m8()); break;
+	case 0xDA: push_reg(x, !x8()); break;
+	case 0x5A: push_reg(y, !x8()); break;
+	case 0x08: push_reg(p, false); break;
+	case 0x8B: push_reg(db, false); break;
+	case 0x4B: push_reg(pb, false); break;
+	case 0x0B: push_reg(d, true); break;
+	case 0x68: {
+		uint16_t value = pull_reg(!m8());
+		a = m8() ? ((a & 0xFF00) | value) : value;
+		break;
+	}
+	case 0xFA: x = pull_reg(!x8()); break;
+	case 0x7A: y = pull_reg(!x8()); break;
+	case 0xAB: db = static_cast<uint8_t>(pull_reg(false)); break;
+	case 0x2B: d = pull_reg(true); break;
+	case 0x28:
+		io(2);
+		set_p(pull8());
+		break;
+	case 0xF4: push16(fetch16()); break;
+	case 0xD4: {
+		uint16_t address = static_cast<uint16_t>(d + fetch8());
+		if (d & 0xFF)
+			io();
+		push16(dp_pointer(address));
+		break;
+	}
+	case 0x62: {
+		uint16_t offset = fetch16();
+		io();
+		push16(static_cast<uint16_t>(pc + offset));
+		break;
+	}
+
+	// branches
+	case 0x10: branch(!(p & N)); break;
+	case 0x30: branch(p & N); break;
+	case 0x50: branch(!(p & V)); break;
+	case 0x70: branch(p & V); break;
+	case 0x90: branch(!(p & C)); break;
+	case 0xB0: branch(p & C); break;
+	case 0xD0: branch(!(p & Z)); break;
+	case 0xF0: branch(p & Z); break;
+	case 0x80: branch(true); break;
+	case 0x82: {
+		uint16_t offset = fetch16();
+		io();
+		pc = static_cast<uint16_t>(pc + offset);
+		break;
+	}
+
+	// jumps, calls and returns
+	case 0x4C: pc = fetch16(); break;
+	case 0x5C: {
+		uint32_t target = fetch24();
+		pc = target & 0xFFFF;
+		pb = target >> 16;
+		break;
+	}
+	case 0x6C: {
+		uint16_t pointer = fetch16();
+		pc = read8(pointer) | (read8(static_cast<uint16_t>(pointer + 1)) << 8);
+		break;
+	}
+	case 0x7C: {
+		uint16_t pointer = static_cast<uint16_t>(fetch16() + x);
+		io();
+		pc = read8((pb << 16) | pointer) | (read8((pb << 16) | static_cast<uint16_t>(pointer + 1)) << 8);
+		break;
+	}
+	case 0xDC: {
+		uint16_t pointer = fetch16();
+		uint32_t target = read8(pointer);
+		target |= read8(static_cast<uint16_t>(pointer + 1)) << 8;
+		target |= read8(static_cast<uint16_t>(pointer + 2)) << 16;
+		pc = target & 0xFFFF;
+		pb = target >> 16;
+		m_jumped_indirect = true;
+		break;
+	}
+	case 0x20: {
+		uint16_t target = fetch16();
+		io();
+		push16(static_cast<uint16_t>(pc - 1));
+		pc = target;
+		break;
+	}
+	case 0xFC: {
+		uint16_t pointer = fetch16();
+		push16(static_cast<uint16_t>(pc - 1));
+		pointer = static_cast<uint16_t>(pointer + x);
+		io();
+		pc = read8((pb << 16) | pointer) | (read8((pb << 16) | static_cast<uint16_t>(pointer + 1)) << 8);
+		break;
+	}
+	case 0x22: {
+		uint16_t target = fetch16();
+		push8(pb);
+		io();
+		uint8_t bank = fetch8();
+		push16(static_cast<uint16_t>(pc - 1));
+		pc = target;
+		pb = bank;
+		break;
+	}
+	case 0x60:
+		io(2);
+		pc = pull16();
+		io();
+		pc++;
+		break;
+	case 0x6B:
+		io(2);
+		pc = pull16();
+		pb = pull8();
+		pc++;
+		break;
+	case 0x40:
+		io(2);
+		set_p(pull8());
+		pc = pull16();
+		pb = pull8();
+		break;
+
+	// block moves
+	case 0x54: block_move(1); break;
+	case 0x44: block_move(-1); break;
+
+	case 0xEA: io(); break;
+	case 0x42: fetch8(); break;
+	case 0x00:
+	case 0x02:
+	case 0xCB:
+	case 0xDB:
+		m_halt = fmt::format("opcode ${:02X} at ${:06X}", opcode, at);
+		break;
+	default:
+		m_halt = fmt::format("unknown opcode ${:02X} at ${:06X}", opcode, at);
+		break;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Rom;
+
+// what the cpu runs on: memory and how long every access takes
+class CpuBus {
+public:
+	virtual ~CpuBus() = default;
+	virtual uint8_t read(uint32_t address) = 0;
+	virtual void write(uint32_t address, uint8_t value) = 0;
+	// master clocks of an access to address and of an internal operation
+	virtual int clocks(uint32_t address) = 0;
+	virtual int io_clocks() = 0;
+};
+
+// whose timings a SnesBus uses: Auto takes the cpu sprites run on, the SA-1 in SA-1 roms and the S-CPU otherwise
+enum class BusClock {
+	Auto,
+	SCpu,
+	Sa1
+};
+
+// the S-CPU with WRAM, or the SA-1 with I-RAM and BW-RAM (sprites run on the SA-1 in SA-1 roms), around a rom
+// the hardware registers aren't there: they read as 0 and writes to them are dropped
+// the memory map follows the rom, the timings can be the other cpu's to see what moving code there would change
+// FastROM timings apply to the $80+ banks when the header of a LoROM rom has the FastROM bit set
+class SnesBus : public CpuBus {
+	Rom& m_rom;
+	bool m_sa1;
+	bool m_sa1_clock;
+	bool m_fastrom;
+	std::vector<uint8_t> m_wram = std::vector<uint8_t>(0x20000);
+	std::vector<uint8_t> m_iram = std::vector<uint8_t>(0x800);
+	std::vector<uint8_t> m_bwram = std::vector<uint8_t>(0x40000);
+
+	uint8_t* memory(uint32_t address);
+public:
+	SnesBus(Rom& rom, BusClock clock = BusClock::Auto);
+
+	bool sa1() const { return m_sa1; }
+	bool sa1_clock() const { return m_sa1_clock; }
+	bool fastrom() const { return m_fastrom; }
+	// the direct page sprite code runs with
+	uint16_t dp() const { return m_sa1 ? 0x3000 : 0x0000; }
+	void clear();
+	uint32_t read_long(uint32_t address);
+
+	uint8_t read(uint32_t address) override;
+	void write(uint32_t address, uint8_t value) override;
+	int clocks(uint32_t address) override;
+	int io_clocks() override;
+};
+
+// a 65816 in native mode, every bus access and internal operation is counted as a cycle
+// emulation mode, interrupts and the hardware registers aren't there: BRK, COP, WAI, STP and XCE into emulation mode halt it
+class Cpu65816 {
+public:
+	enum Flag : uint8_t {
+		C = 0x01,
+		Z = 0x02,
+		I = 0x04,
+		D = 0x08,
+		X = 0x10,
+		M = 0x20,
+		V = 0x40,
+		N = 0x80
+	};
+
+	uint16_t a = 0;
+	uint16_t x = 0;
+	uint16_t y = 0;
+	uint16_t s = 0x01FF;
+	uint16_t d = 0;
+	uint8_t db = 0;
+	uint8_t pb = 0;
+	uint16_t pc = 0;
+	uint8_t p = M | X | I;
+
+	uint64_t cycles = 0;
+	uint64_t clocks = 0;
+	// indexed reads always take the cycle of a page crossing, for worst case estimates of code that isn't run for real
+	bool always_cross_pages = false;
+
+	Cpu65816(CpuBus& bus) : m_bus(bus) {}
+
+	uint32_t address() const { return (pb << 16) | pc; }
+	bool halted() const { return !m_halt.empty(); }
+	const std::string& halt_reason() const { return m_halt; }
+	// whether the last instruction was a JML [abs], which is how every sprite gets called
+	bool jumped_indirect() const { return m_jumped_indirect; }
+
+	void set_p(uint8_t value);
+	void push8(uint8_t value);
+	void step();
+	// runs an RTL as if it were the instruction at the current address, for code that isn't there
+	void return_long();
+
+private:
+	CpuBus& m_bus;
+	std::string m_halt{};
+	bool m_jumped_indirect = false;
+
+	struct Operand {
+		uint32_t address;
+		// direct page and stack relative operands wrap inside bank 0
+		bool bank0;
+	};
+	enum class Mode {
+		Dp, DpX, DpY, DpInd, DpIndLong, DpXInd, DpIndY, DpIndLongY,
+		Abs, AbsX, AbsY, Long, LongX, Sr, SrIndY
+	};
+
+	bool m8() const { return p & M; }
+	bool x8() const { return p & X; }
+	void io(int count = 1);
+	uint8_t read8(uint32_t address);
+	void write8(uint32_t address, uint8_t value);
+	uint8_t fetch8();
+	uint16_t fetch16();
+	uint32_t fetch24();
+	uint8_t pull8();
+	void push16(uint16_t value);
+	uint16_t pull16();
+	uint32_t next(const Operand& op) const;
+	uint16_t load(const Operand& op, bool wide);
+	void store(const Operand& op, uint16_t value, bool wide);
+	uint16_t dp_pointer(uint16_t address);
+	// the operand of mode, write says whether the indexed modes take their extra cycle anyway
+	Operand operand(Mode mode, bool write);
+	uint16_t immediate(bool wide);
+
+	void set_nz(uint16_t value, bool wide);
+	uint16_t adc(uint16_t value, bool wide, bool subtract);
+	void compare(uint16_t reg, uint16_t value, bool wide);
+	uint16_t shift(int kind, uint16_t value, bool wide);
+	void accumulator_op(int group, uint16_t value);
+	void modify(int kind, Mode mode);
+	void branch(bool taken);
+};
\ No newline at end of file
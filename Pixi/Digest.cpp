@@ -0,0 +1,107 @@
+#include "Digest.h"
+#include <map>
+
+static constexpr std::array<const char*, 4> outputs{ "ssc", "mwt", "mw2", "s16" };
+
+static uint64_t hash_string(std::string_view str, uint64_t hash) {
+	// the size goes in first so that "ab" + "c" and "a" + "bc" don't hash the same
+	size_t size = str.size();
+	hash = fnv1a_hash(&size, sizeof(size), hash);
+	return fnv1a_hash(str.data(), str.size(), hash);
+}
+
+static uint64_t hash_file(const std::string& path, uint64_t hash) {
+	auto content = file_hash(path);
+	uint64_t value = content.value_or(0);
+	bool exists = content.has_value();
+	hash = fnv1a_hash(&exists, sizeof(exists), hash);
+	return fnv1a_hash(&value, sizeof(value), hash);
+}
+
+// every file in the folder and its subfolders, in a fixed order, except the ones pixi writes itself
+static uint64_t hash_dir(const std::string& dir, uint64_t hash) {
+	std::error_code ec{};
+	if (!std::filesystem::is_directory(dir, ec))
+		return hash_string("<missing>", hash);
+	std::map<std::string, std::string> files{};
+	for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		std::string name = it->path().filename().string();
+		if (!it->is_regular_file(ec) || is_generated_file(name) || name[0] == '.')
+			continue;
+		files.emplace(std::filesystem::relative(it->path(), dir, ec).generic_string(), it->path().string());
+	}
+	for (const auto& [relative, path] : files) {
+		hash = hash_string(relative, hash);
+		hash = hash_file(path, hash);
+	}
+	return hash;
+}
+
+uint64_t inputs_digest(const PixiConfig& cfg) {
+	uint64_t hash = fnv1a_hash(nullptr, 0);
+	hash = hash_string(fmt::format("{} {} {} {} {} {} {} {} {} {}", PixiConfig::VERSION, cfg.PerLevel, cfg.disable255Sprites, cfg.FastRom,
+		cfg.PlanarPointers, cfg.ExtMod, cfg.DisableMeiMei, cfg.m_meimei.always, cfg.Routines, FromEnum(cfg.Output)), hash);
+	for (int i = 0; i < FromEnum(PathType::SIZE); i++) {
+		hash = hash_string(cfg.m_Paths[i], hash);
+		if (i == FromEnum(PathType::List))
+			hash = hash_file(cfg.m_Paths[i], hash);
+		else
+			hash = hash_dir(cfg.m_Paths[i], hash);
+	}
+	for (int i = 0; i < FromEnum(ExtType::SIZE); i++) {
+		hash = hash_string(cfg.m_Extensions[i], hash);
+		if (!cfg.m_Extensions[i].empty())
+			hash = hash_file(cfg.m_Extensions[i], hash);
+	}
+	return hash;
+}
+
+static std::string digest_string(std::optional<uint64_t> digest) {
+	return digest.has_value() ? fmt::format("{:016X}", *digest) : "";
+}
+
+bool insertion_up_to_date(const PixiConfig& cfg, uint64_t inputs) {
+	// the report is made while inserting
+	if (cfg.Output != RomOutput::Rom || cfg.CostReport)
+		return false;
+	std::string record_name = subfile_name(cfg.RomName, "pixi");
+	auto mismatch = [&cfg](std::string_view reason) {
+		if (cfg.Debug)
+			fmt::print("Full insertion: {}\n", reason);
+		return false;
+	};
+	if (!std::filesystem::exists(record_name))
+		return mismatch("there's no record of a previous insertion");
+	toml::table record{};
+	try {
+		record = toml::parse_file(record_name);
+	}
+	catch (const toml::parse_error&) {
+		return mismatch(fmt::format("{} couldn't be parsed", record_name));
+	}
+	if (record["version"].value_or(0) != PixiConfig::VERSION)
+		return mismatch("the previous insertion was done by a different version of pixi");
+	if (record["inputs"].value_or(std::string{}) != digest_string(inputs))
+		return mismatch("the inputs changed since the previous insertion");
+	if (record["rom"].value_or(std::string{}) != digest_string(file_hash(cfg.RomName)))
+		return mismatch("the rom changed since the previous insertion");
+	for (const char* ext : outputs) {
+		if (record["outputs"][ext].value_or(std::string{}) != digest_string(file_hash(subfile_name(cfg.RomName, ext))))
+			return mismatch(fmt::format("the .{} file changed since the previous insertion", ext));
+	}
+	return true;
+}
+
+void record_insertion(const PixiConfig& cfg, uint64_t inputs) {
+	toml::table record_outputs{};
+	for (const char* ext : outputs)
+		record_outputs.insert(ext, digest_string(file_hash(subfile_name(cfg.RomName, ext))));
+	auto record = toml::table{ {
+		{"version", PixiConfig::VERSION},
+		{"inputs", digest_string(inputs)},
+		{"rom", digest_string(file_hash(cfg.RomName))},
+		{"outputs", record_outputs}
+	} };
+	std::ofstream file{ subfile_name(cfg.RomName, "pixi") };
+	file << record;
+}
\ No newline at end of file
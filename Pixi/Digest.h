@@ -0,0 +1,12 @@
+#pragma once
+#include "Config.h"
+
+// no-op fast path: after every successful insertion into the rom itself a `<ROM>.pixi` record is written next to it,
+// with a digest of all the inputs (list, sprite/routine/asm folders, extension files, options, pixi version)
+// and of the rom and the .ssc/.mwt/.mw2/.s16 files that came out of it.
+// when the next run finds the same digests, there is nothing to insert and asar isn't even loaded.
+
+// the paths in cfg have to be corrected already
+uint64_t inputs_digest(const PixiConfig& cfg);
+bool insertion_up_to_date(const PixiConfig& cfg, uint64_t inputs);
+void record_insertion(const PixiConfig& cfg, uint64_t inputs);
\ No newline at end of file
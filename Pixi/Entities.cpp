@@ -1,20 +1,20 @@
 #include "Entities.h"
 
 auto cfg_type(const std::string& line, Sprite& spr) {
-	spr.table.type = (uint8_t)std::stoi(line, nullptr, 16);
+	spr.table->type = (uint8_t)std::stoi(line, nullptr, 16);
 }
 
 auto cfg_actlike(const std::string& line, Sprite& spr) {
-	spr.table.actlike = (uint8_t)std::stoi(line, nullptr, 16);
+	spr.table->actlike = (uint8_t)std::stoi(line, nullptr, 16);
 }
 
 auto cfg_tweak(const std::string& line, Sprite& spr) {
-	sscanf(line.c_str(), "%hhx %hhx %hhx %hhx %hhx %hhx", &spr.table.tweak[0], &spr.table.tweak[1], &spr.table.tweak[2],
-		&spr.table.tweak[3], &spr.table.tweak[4], &spr.table.tweak[5]);
+	sscanf(line.c_str(), "%hhx %hhx %hhx %hhx %hhx %hhx", &spr.table->tweak[0], &spr.table->tweak[1], &spr.table->tweak[2],
+		&spr.table->tweak[3], &spr.table->tweak[4], &spr.table->tweak[5]);
 }
 
 auto cfg_prop(const std::string& line, Sprite& spr) {
-	sscanf(line.c_str(), "%hhx %hhx", &spr.table.extra[0], &spr.table.extra[1]);
+	sscanf(line.c_str(), "%hhx %hhx", &spr.table->extra[0], &spr.table->extra[1]);
 }
 auto cfg_asm(const std::string& line, Sprite& spr) {
 	spr.asm_file = append_to_dir(spr.cfg_file, line);
@@ -60,28 +60,73 @@ Pointer::Pointer(size_t snes)
 	bankbyte = (uint8_t)((snes >> 16) & 0xFF);
 }
 
-Pointer::Pointer(const Pointer& other) {
-	lowbyte = other.lowbyte;
-	highbyte = other.highbyte;
-	bankbyte = other.bankbyte;
+size_t PerLevelSprites::probe(uint32_t key) const {
+	const size_t mask = m_keys.size() - 1;
+	size_t pos = (size_t)((key * 0x9E3779B1u) >> 7) & mask;
+	while (m_keys[pos] != EMPTY_KEY && m_keys[pos] != key)
+		pos = (pos + 1) & mask;
+	return pos;
 }
 
-Pointer& Pointer::operator=(const Pointer& other) {
-	lowbyte = other.lowbyte;
-	highbyte = other.highbyte;
-	bankbyte = other.bankbyte;
-	return *this;
+void PerLevelSprites::grow() {
+	std::vector<uint32_t> old_keys = std::move(m_keys);
+	std::vector<int> old_entries = std::move(m_entries);
+	size_t capacity = old_keys.empty() ? 0x40 : old_keys.size() * 2;
+	m_keys.assign(capacity, EMPTY_KEY);
+	m_entries.assign(capacity, NOT_FOUND);
+	for (size_t i = 0; i < old_keys.size(); i++) {
+		if (old_keys[i] == EMPTY_KEY)
+			continue;
+		size_t pos = probe(old_keys[i]);
+		m_keys[pos] = old_keys[i];
+		m_entries[pos] = old_entries[i];
+	}
+}
+
+int PerLevelSprites::find(int level, int number) const {
+	if (m_keys.empty())
+		return NOT_FOUND;
+	return m_entries[probe(make_key(level, number))];
+}
+
+int PerLevelSprites::insert(int level, int number, int owner, Sprite& spr) {
+	// keep the load factor under 1/2 so probes stay short
+	if ((size() + 1) * 2 > m_keys.size())
+		grow();
+	uint32_t key = make_key(level, number);
+	size_t pos = probe(key);
+	if (m_keys[pos] == key)
+		return NOT_FOUND;
+	int entry = (int)size();
+	m_keys[pos] = key;
+	m_entries[pos] = entry;
+	m_entry_keys.push_back(key);
+	m_owners.push_back(owner);
+	spr.table = &m_tables.emplace_back();
+	spr.ptrs = &m_ptrs.emplace_back();
+	spr.extended_cape_ptr = &m_cape_ptrs.emplace_back();
+	return entry;
+}
+
+std::vector<size_t> PerLevelSprites::sorted_entries() const {
+	std::vector<size_t> entries(size());
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i] = i;
+	std::sort(entries.begin(), entries.end(), [this](size_t a, size_t b) {
+		return m_entry_keys[a] < m_entry_keys[b];
+	});
+	return entries;
 }
 
 void Sprite::print(FILE* stream)
 {
-	fmt::print(stream, "Type:       {:02X}\n", table.type);
-	fmt::print(stream, "ActLike:    {:02X}\n", table.actlike);
+	fmt::print(stream, "Type:       {:02X}\n", table->type);
+	fmt::print(stream, "ActLike:    {:02X}\n", table->actlike);
 	fmt::print(stream, "Tweak:      {:02X}, {:02X}, {:02X}, {:02X}, {:02X}, {:02X}\n",
-		table.tweak[0], table.tweak[1], table.tweak[2], table.tweak[3], table.tweak[4], table.tweak[5]);
+		table->tweak[0], table->tweak[1], table->tweak[2], table->tweak[3], table->tweak[4], table->tweak[5]);
 
-	if (table.type) {
-		fmt::print(stream, "Extra:      {:02X}, {:02X}\n", table.extra[0], table.extra[1]);
+	if (table->type) {
+		fmt::print(stream, "Extra:      {:02X}, {:02X}\n", table->extra[0], table->extra[1]);
 		fmt::print(stream, "ASM File:   {}\n", asm_file);
 		fmt::print(stream, "Byte Count: {}, {}\n", byte_count, extra_byte_count);
 	}
@@ -160,15 +205,15 @@ void Sprite::from_json(PixiConfig& cfg)
 		}
 	}
 
-	table.actlike = j.at("ActLike");
-	table.type = j.at("Type");
+	table->actlike = j.at("ActLike");
+	table->type = j.at("Type");
 
-	if (table.type) {
+	if (table->type) {
 		std::string unrooted_asm_file = j.at("AsmFile");
 		asm_file = append_to_dir(cfg_file, unrooted_asm_file);
 
-		table.extra[0] = j.at("Extra Property Byte 1");
-		table.extra[1] = j.at("Extra Property Byte 2");
+		table->extra[0] = j.at("Extra Property Byte 1");
+		table->extra[1] = j.at("Extra Property Byte 2");
 
 		byte_count = j.at("Additional Byte Count (extra bit clear)");
 		extra_byte_count = j.at("Additional Byte Count (extra bit set)");
@@ -176,12 +221,12 @@ void Sprite::from_json(PixiConfig& cfg)
 		extra_byte_count = std::clamp(extra_byte_count, 0, 15);
 	}
 
-	table.tweak[0] = JsonData<J1656>(j, "$1656").get<uint8_t>();
-	table.tweak[1] = JsonData<J1662>(j, "$1662").get<uint8_t>();
-	table.tweak[2] = JsonData<J166E>(j, "$166E").get<uint8_t>();
-	table.tweak[3] = JsonData<J167A>(j, "$167A").get<uint8_t>();
-	table.tweak[4] = JsonData<J1686>(j, "$1686").get<uint8_t>();
-	table.tweak[5] = JsonData<J190F>(j, "$190F").get<uint8_t>();
+	table->tweak[0] = JsonData<J1656>(j, "$1656").get<uint8_t>();
+	table->tweak[1] = JsonData<J1662>(j, "$1662").get<uint8_t>();
+	table->tweak[2] = JsonData<J166E>(j, "$166E").get<uint8_t>();
+	table->tweak[3] = JsonData<J167A>(j, "$167A").get<uint8_t>();
+	table->tweak[4] = JsonData<J1686>(j, "$1686").get<uint8_t>();
+	table->tweak[5] = JsonData<J190F>(j, "$190F").get<uint8_t>();
 
 	auto decoded = base64_decode(j.at("Map16"));
 	map_data.reserve(decoded.size() / sizeof(Map16));
@@ -288,17 +333,4 @@ void Sprite::from_cfg() {
 		nline++;
 	}
 	DEBUGFMTMSG("Parsed {}, {} lines\n", cfg_file, nline - 1);
-}
-
-StatusPointers::StatusPointers(const StatusPointers& other)
-{
-	for (size_t i = 0; i < other.pointers.size(); i++)
-		pointers[i] = other.pointers[i];
-}
-
-StatusPointers& StatusPointers::operator=(const StatusPointers& other)
-{
-	for (size_t i = 0; i < other.pointers.size(); i++)
-		pointers[i] = other.pointers[i];
-	return *this;
-}
+}
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <iomanip>
 #include <fstream>
 #include <algorithm>
+#include <type_traits>
+#include <deque>
+#include <vector>
 #include "base64/base64.h"
 #include "JsonData.h"
 #include "Config.h"
@@ -26,8 +29,8 @@ struct Pointer {
 
 	Pointer() = default;
 	Pointer(size_t snes);
-	Pointer(const Pointer& other);
-	Pointer& operator=(const Pointer& other);
+	Pointer(const Pointer& other) = default;
+	Pointer& operator=(const Pointer& other) = default;
 
 	~Pointer() = default;
 
@@ -35,10 +38,11 @@ struct Pointer {
 		return lowbyte == RTL_LOW && highbyte == RTL_HIGH && bankbyte == RTL_BANK;
 	}
 
-	size_t addr() {
+	size_t addr() const {
 		return (bankbyte << 16) + (highbyte << 8) + lowbyte;
 	}
 };
+static_assert(sizeof(Pointer) == 3 && std::is_trivially_copyable_v<Pointer>);
 
 struct Tile {
 	int x_offset = 0;
@@ -101,12 +105,20 @@ struct Map16 {
 	constexpr Map8x8& bottom_left() { return corners[1]; };
 	constexpr Map8x8& top_right() { return corners[2]; };
 	constexpr Map8x8& bottom_right() { return corners[3]; };
+
+	// raw 8 bytes of the block, used to find identical blocks
+	uint64_t key() const {
+		uint64_t k = 0;
+		memcpy(&k, corners.data(), sizeof(k));
+		return k;
+	}
 };
+static_assert(sizeof(Map16) == 8 && std::is_trivially_copyable_v<Map16>, "Map16 is written as-is to the s16 file");
 
 struct StatusPointers {
 	StatusPointers() = default;
-	StatusPointers(const StatusPointers& other);
-	StatusPointers& operator=(const StatusPointers& other);
+	StatusPointers(const StatusPointers& other) = default;
+	StatusPointers& operator=(const StatusPointers& other) = default;
 
 	std::array<Pointer, 5> pointers{ { {}, {}, {}, {}, {} } };
 	constexpr Pointer& carriable() {
@@ -125,6 +137,7 @@ struct StatusPointers {
 		return pointers[4];
 	};
 };
+static_assert(sizeof(StatusPointers) == 15 && std::is_trivially_copyable_v<StatusPointers>);
 
 struct SpriteTable {
 	uint8_t type = 0;
@@ -134,22 +147,22 @@ struct SpriteTable {
 	Pointer main{};
 	uint8_t extra[2] = { 0 };
 };
+static_assert(sizeof(SpriteTable) == 0x10 && std::is_trivially_copyable_v<SpriteTable>);
 
+// cold part of a sprite, only exists for the sprites actually listed in the list file
+// the table data lives in a SpriteTableStore and is accessed through the pointers bound to it
 struct Sprite {
-	static constexpr bool INVALID = true;
-	static constexpr int MAX_SPRITE_COUNT = 0x2100;
 	static constexpr int SPRITE_COUNT = 0x80;
 	static constexpr int INIT_PTR = 0x01817D;
 	static constexpr int MAIN_PTR = 0x0185CC;
 	static constexpr const char* TEMP_SPR_FILE = "spr_temp.asm";
 
-	bool invalid = false;
 	int line = 0;
 	int number = 0;
 	int level = 0x200;
-	SpriteTable table;
-	StatusPointers ptrs;
-	Pointer extended_cape_ptr;
+	SpriteTable* table = nullptr;
+	StatusPointers* ptrs = nullptr;
+	Pointer* extended_cape_ptr = nullptr;
 	int byte_count = 0;
 	int extra_byte_count = 0;
 
@@ -164,11 +177,79 @@ struct Sprite {
 	DisplayType display_type = DisplayType::XYPosition;
 	int sprite_type = 0;
 	Sprite() = default;
-	Sprite(bool inv) : invalid(inv) {};
 	~Sprite() = default;
 
 	void print(FILE*);
 	void parse(PixiConfig& cfg);
 	void from_json(PixiConfig& cfg);
 	void from_cfg();
+};
+
+// hot part of the sprites, structure of arrays indexed by slot
+// each array has exactly the layout of the matching rom table so it can be written out in one go
+class SpriteTableStore {
+	std::vector<SpriteTable> m_tables;
+	std::vector<StatusPointers> m_ptrs;
+	std::vector<Pointer> m_cape_ptrs;
+	std::vector<int> m_owners;
+public:
+	static constexpr int EMPTY = -1;
+
+	SpriteTableStore(size_t slots) : m_tables(slots), m_ptrs(slots), m_cape_ptrs(slots), m_owners(slots, EMPTY) {}
+	SpriteTableStore(const SpriteTableStore& other) = delete;
+	SpriteTableStore& operator=(const SpriteTableStore& other) = delete;
+
+	size_t size() const { return m_tables.size(); }
+
+	// index of the sprite in the cold store that occupies the slot, EMPTY if none
+	int owner(size_t slot) const { return m_owners[slot]; }
+
+	void bind(size_t slot, int owner, Sprite& spr) {
+		m_owners[slot] = owner;
+		spr.table = &m_tables[slot];
+		spr.ptrs = &m_ptrs[slot];
+		spr.extended_cape_ptr = &m_cape_ptrs[slot];
+	}
+
+	const SpriteTable& table(size_t slot) const { return m_tables[slot]; }
+
+	const uint8_t* table_bytes(size_t slot) const { return reinterpret_cast<const uint8_t*>(m_tables.data() + slot); }
+	const uint8_t* ptrs_bytes(size_t slot) const { return reinterpret_cast<const uint8_t*>(m_ptrs.data() + slot); }
+	const uint8_t* cape_ptrs_bytes(size_t slot) const { return reinterpret_cast<const uint8_t*>(m_cape_ptrs.data() + slot); }
+};
+
+// per-level sprites (B0-BF assigned to a level), only the sprites that are actually listed get stored
+// open addressing map keyed by (level << 8) | number, the tables live in deques so the pointers bound to the sprites stay valid
+class PerLevelSprites {
+	static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+	std::vector<uint32_t> m_keys{};
+	std::vector<int> m_entries{};
+	std::vector<uint32_t> m_entry_keys{};
+	std::vector<int> m_owners{};
+	std::deque<SpriteTable> m_tables{};
+	std::deque<StatusPointers> m_ptrs{};
+	std::deque<Pointer> m_cape_ptrs{};
+
+	static constexpr uint32_t make_key(int level, int number) { return ((uint32_t)level << 8) | (uint32_t)number; }
+	size_t probe(uint32_t key) const;
+	void grow();
+public:
+	static constexpr int NOT_FOUND = -1;
+
+	PerLevelSprites() = default;
+	PerLevelSprites(const PerLevelSprites& other) = delete;
+	PerLevelSprites& operator=(const PerLevelSprites& other) = delete;
+
+	size_t size() const { return m_entry_keys.size(); }
+	int find(int level, int number) const;
+	int insert(int level, int number, int owner, Sprite& spr);
+
+	// entry indexes ordered by level and then sprite number, which is the order the rom tables expect
+	std::vector<size_t> sorted_entries() const;
+
+	int owner(size_t entry) const { return m_owners[entry]; }
+	int level(size_t entry) const { return (int)(m_entry_keys[entry] >> 8); }
+	int number(size_t entry) const { return (int)(m_entry_keys[entry] & 0xFF); }
+	const uint8_t* table_bytes(size_t entry) const { return reinterpret_cast<const uint8_t*>(&m_tables[entry]); }
+	const uint8_t* ptrs_bytes(size_t entry) const { return reinterpret_cast<const uint8_t*>(&m_ptrs[entry]); }
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+﻿#include "Pixi.h"
+
+int main(int argc, char* argv[]) {
+	if (argc < 2)
+		wait_before_exit(argc);
+	try {
+		// the client only forwards the command line, it doesn't need asar at all
+		if (argc >= 2 && std::string_view{ argv[1] } == "--client")
+			return pixi_client(argc, argv);
+		// neither does the benchmark, it only reads the rom
+		if (argc >= 2 && std::string_view{ argv[1] } == "--bench")
+			return pixi_bench(argc, argv);
+		bool serve = argc >= 2 && std::string_view{ argv[1] } == "--serve";
+		bool watch = argc >= 2 && std::string_view{ argv[1] } == "--watch";
+		bool batch = argc >= 2 && std::string_view{ argv[1] } == "--batch";
+		// a single insertion loads asar itself, only if the rom isn't already up to date
+		if ((serve || watch || batch) && !ErrorState::asar_init_wrap())
+			ErrorState::pixi_error("Asar library is missing or couldn't be initialized, please redownload the tool or the dll.\n");
+		if (serve)
+			return pixi_serve(argc, argv);
+		if (watch)
+			return pixi_watch(argc, argv);
+		if (batch)
+			return pixi_batch(argc, argv);
+		PixiConfig cfg{ argc, argv };
+		return run_pixi(cfg);
+	}
+	catch (const PixiException&) {
+		// the error was already reported by pixi_error
+		ErrorState::asar_close_wrap();
+		return 1;
+	}
+}
\ No newline at end of file
@@ -23,18 +23,17 @@ bool MeiMei::patch(MemoryFile& patch, Rom& rom, PixiConfig& cfg, MemoryFile& bin
     return true;
 }
 
-MeiMei::MeiMei(const MeiMeiConfig& cfg, const std::string& rom_name) : 
-    name(rom_name),
-    prev(name),
+MeiMei::MeiMei(const MeiMeiConfig& cfg, Rom& rom) :
     always(cfg.always),
     debug(cfg.debug),
     keepTemp(cfg.keep)
 {
     prevEx.fill(0x00);
     nowEx.fill(0x00);
-    if (prev.read_byte(0x07730F) == 0x42) {
-        int addr = prev.snes_to_pc(prev.read_long(0x07730C), false);
-        prevEx.write(prev.data().ptr_at(addr), prevEx.size());
+    prevHasEx = rom.read_byte(0x07730F) == 0x42;
+    if (prevHasEx) {
+        int addr = rom.snes_to_pc(rom.read_long(0x07730C), false);
+        prevEx.write(rom.data().ptr_at(addr), prevEx.size());
     }
 }
 
@@ -52,31 +51,20 @@ bool MeiMei::overSize(int size) {
     return false;
 }
 
-int MeiMei::run(PixiConfig& cfg) {
-    Rom rom(name);
-    if (!ErrorState::asar_init_wrap()) {
-        ErrorState::pixi_error("Error: Asar library is missing or couldn't be initialized, please redownload the tool or add the dll.\n");
-    }
-
-    int returnValue = run(rom, cfg);
+int MeiMei::run(Rom& rom, PixiConfig& cfg) {
+    int returnValue = remap(rom, cfg);
 
     if (returnValue) {
-        prev.close();
-        ErrorState::asar_close_wrap();
+        rom.rollback(rom.loaded());
         fmt::print("\n\nError occurred in MeiMei.\nYour rom has reverted to before pixi insert.\n");
-        return returnValue;
     }
-
-    rom.close();
-    ErrorState::asar_close_wrap();
     return returnValue;
 }
 
-int MeiMei::run(Rom& rom, PixiConfig& cfg) {
-    Rom now(name);
-    if (prev.read_byte(0x07730F) == 0x42) {
-        int addr = now.snes_to_pc(now.read_long(0x07730C), false);
-        nowEx.write(now.data().ptr_at(addr), 0x400);
+int MeiMei::remap(Rom& rom, PixiConfig& cfg) {
+    if (prevHasEx) {
+        int addr = rom.snes_to_pc(rom.read_long(0x07730C), false);
+        nowEx.write(rom.data().ptr_at(addr), 0x400);
     }
 
     bool changeEx = false;
@@ -98,17 +86,12 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
         sprAllData.fill(0x00);
         ByteArray<uint8_t, 3> sprCommonData{};
         sprCommonData.fill(0x00);
-        bool remapped[0x0200];
-        for (int i = 0; i < 0x0200; i++) {
-            remapped[i] = false;
-        }
+        // every level is read before the first remapping patch changes the rom
+        std::vector<std::pair<int, std::vector<uint8_t>>> remaps{};
 
         for (int lv = 0; lv < 0x200; lv++) {
-            if (remapped[lv])
-                continue;
-
-            int sprAddrSNES = (now.read_byte(0x077100 + lv) << 16) + now.read_word(0x02EC00 + lv * 2);
-            int sprAddrPC = now.snes_to_pc(sprAddrSNES, false);
+            int sprAddrSNES = (rom.read_byte(0x077100 + lv) << 16) + rom.read_word(0x02EC00 + lv * 2);
+            int sprAddrPC = rom.snes_to_pc(sprAddrSNES, false);
             if (sprAddrPC == -1) {
                 fmt::print("Sprite Data has invalid address. Address: ${:06X}\n", sprAddrSNES);
                 return validate(revert);
@@ -118,14 +101,14 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
                 sprAllData[i] = 0;
             }
 
-            sprAllData[0] = now.read_byte(sprAddrPC);
+            sprAllData[0] = rom.read_byte(sprAddrPC);
             int prevOfs = 1;
             int nowOfs = 1;
             bool exlevelFlag = sprAllData[0] & (uint8_t)0x20;
             bool changeData = false;
 
             while (true) {
-                sprCommonData.write(now.data().ptr_at(sprAddrPC + prevOfs), 3);
+                sprCommonData.write(rom.data().ptr_at(sprAddrPC + prevOfs), 3);
                 if (nowOfs >= SPR_ADDR_LIMIT - 3) {
                     fmt::print("Sprite data is too large! Size is {:X}", nowOfs);
                     return validate(revert);
@@ -143,7 +126,7 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
                     }
                     else {
                         prevOfs += 2;
-                        sprCommonData.write(now.data().ptr_at(sprAddrPC + prevOfs), 3);
+                        sprCommonData.write(rom.data().ptr_at(sprAddrPC + prevOfs), 3);
                     }
                 }
 
@@ -157,7 +140,7 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
                     changeData = true;
                     int i;
                     for (i = 3; i < prevEx[sprNum]; i++) {
-                        sprAllData[nowOfs++] = now.read_byte(sprAddrPC + prevOfs + i);
+                        sprAllData[nowOfs++] = rom.read_byte(sprAddrPC + prevOfs + i);
                         if (overSize(nowOfs)) return validate(revert);
                     }
                     for (; i < nowEx[sprNum]; i++) {
@@ -168,13 +151,13 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
                 else if (nowEx[sprNum] < prevEx[sprNum]) {
                     changeData = true;
                     for (int i = 3; i < nowEx[sprNum]; i++) {
-                        sprAllData[nowOfs++] = now.read_byte(sprAddrPC + prevOfs + i);
+                        sprAllData[nowOfs++] = rom.read_byte(sprAddrPC + prevOfs + i);
                         if (overSize(nowOfs)) return validate(revert);
                     }
                 }
                 else {
                     for (int i = 3; i < nowEx[sprNum]; i++) {
-                        sprAllData[nowOfs++] = now.read_byte(sprAddrPC + prevOfs + i);
+                        sprAllData[nowOfs++] = rom.read_byte(sprAddrPC + prevOfs + i);
                         if (overSize(nowOfs)) return validate(revert);
                     }
                 }
@@ -182,49 +165,50 @@ int MeiMei::run(Rom& rom, PixiConfig& cfg) {
             }
 
             prevOfs++;
-            if (changeData) {
-                // create sprite data binary
-                MemoryFile binFile{ fmt::format("_tmp_bin_{:X}.bin", lv), keepTemp };
-                MemoryFile spriteDataPatch{ fmt::format("_tmp_{:X}.asm", lv), keepTemp };
-                binFile.insertBytes(sprAllData.start(), sprAllData.size());
-
-                // create patch for sprite data binary
-                std::string binaryLabel = fmt::format("SpriteData{:X}", lv);
-                std::string levelBankAddress = fmt::format("{:06X}", now.pc_to_snes(0x077100 + lv, false));
-                std::string levelWordAddress = fmt::format("{:06X}", now.pc_to_snes(0x02EC00 + lv * 2, false));
-
-                // create actual asar patch
-                spriteDataPatch.insertString("incsrc \"{}\"\n\n", sa1DefPath);
-                spriteDataPatch.insertString("!oldDataPointer = read2(${})|(read1(${})<<16)\n", levelWordAddress, levelBankAddress);
-                spriteDataPatch.insertString("!oldDataSize = read2(pctosnes(snestopc(!oldDataPointer)-4))+1\n");
-                spriteDataPatch.insertString("autoclean !oldDataPointer\n\n");
-                spriteDataPatch.insertString("org ${}\n", levelBankAddress);
-                spriteDataPatch.insertString("\tdb {}>>16\n\n", binaryLabel);
-                spriteDataPatch.insertString("org ${}\n", levelWordAddress);
-                spriteDataPatch.insertString("\tdw {}\n\n", binaryLabel);
-                spriteDataPatch.insertString("freedata cleaned\n");
-                spriteDataPatch.insertString("{}:\n", binaryLabel);
-                spriteDataPatch.insertString("\t!newDataPointer = {}\n", binaryLabel);
-                spriteDataPatch.insertString("\tincbin {}\n", binFile.Path());
-                spriteDataPatch.insertString("{}_end:\n", binaryLabel);
-                spriteDataPatch.insertString("\tprint \"Data pointer  $\",hex(!oldDataPointer),\" : $\",hex(!newDataPointer)\n");
-                spriteDataPatch.insertString("\tprint \"Data size     $\",hex(!oldDataSize),\" : $\",hex({}_end-{}-1)\n", binaryLabel, binaryLabel);
-
-                if (debug) {
-                    fmt::print("__________________________________\n"); 
-                    fmt::print("Fixing sprite data for level {:X}", lv);
-                }
+            if (changeData)
+                remaps.emplace_back(lv, std::vector<uint8_t>(sprAllData.start(), sprAllData.start() + sprAllData.size()));
+        }
 
-                if (!patch(spriteDataPatch, rom, cfg, binFile)) {
-                    fmt::print("An error occured when patching sprite data with asar.");
-                    return validate(revert);
-                }
+        for (const auto& [lv, levelData] : remaps) {
+            // create sprite data binary
+            MemoryFile binFile{ fmt::format("_tmp_bin_{:X}.bin", lv), keepTemp };
+            MemoryFile spriteDataPatch{ fmt::format("_tmp_{:X}.asm", lv), keepTemp };
+            binFile.insertBytes(levelData.data(), levelData.size());
+
+            // create patch for sprite data binary
+            std::string binaryLabel = fmt::format("SpriteData{:X}", lv);
+            std::string levelBankAddress = fmt::format("{:06X}", rom.pc_to_snes(0x077100 + lv, false));
+            std::string levelWordAddress = fmt::format("{:06X}", rom.pc_to_snes(0x02EC00 + lv * 2, false));
+
+            // create actual asar patch
+            spriteDataPatch.insertString("incsrc \"{}\"\n\n", sa1DefPath);
+            spriteDataPatch.insertString("!oldDataPointer = read2(${})|(read1(${})<<16)\n", levelWordAddress, levelBankAddress);
+            spriteDataPatch.insertString("!oldDataSize = read2(pctosnes(snestopc(!oldDataPointer)-4))+1\n");
+            spriteDataPatch.insertString("autoclean !oldDataPointer\n\n");
+            spriteDataPatch.insertString("org ${}\n", levelBankAddress);
+            spriteDataPatch.insertString("\tdb {}>>16\n\n", binaryLabel);
+            spriteDataPatch.insertString("org ${}\n", levelWordAddress);
+            spriteDataPatch.insertString("\tdw {}\n\n", binaryLabel);
+            spriteDataPatch.insertString("freedata cleaned\n");
+            spriteDataPatch.insertString("{}:\n", binaryLabel);
+            spriteDataPatch.insertString("\t!newDataPointer = {}\n", binaryLabel);
+            spriteDataPatch.insertString("\tincbin {}\n", binFile.Path());
+            spriteDataPatch.insertString("{}_end:\n", binaryLabel);
+            spriteDataPatch.insertString("\tprint \"Data pointer  $\",hex(!oldDataPointer),\" : $\",hex(!newDataPointer)\n");
+            spriteDataPatch.insertString("\tprint \"Data size     $\",hex(!oldDataSize),\" : $\",hex({}_end-{}-1)\n", binaryLabel, binaryLabel);
+
+            if (debug) {
+                fmt::print("__________________________________\n"); 
+                fmt::print("Fixing sprite data for level {:X}", lv);
+            }
 
-                if (debug) {
-                    fmt::print("Done!\n");
-                }
+            if (!patch(spriteDataPatch, rom, cfg, binFile)) {
+                fmt::print("An error occured when patching sprite data with asar.");
+                return validate(revert);
+            }
 
-                remapped[lv] = true;
+            if (debug) {
+                fmt::print("Done!\n");
             }
         }
 
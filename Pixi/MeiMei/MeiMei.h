@@ -4,8 +4,8 @@
 class MeiMei {
 private:
     constexpr static inline int SPR_ADDR_LIMIT = 0x800;
-    std::string name;
-    Rom prev;
+    // whether the rom had the extra bytes table before the insertion
+    bool prevHasEx = false;
     ByteArray<uint8_t, 0x400> prevEx{};
     ByteArray<uint8_t, 0x400> nowEx{};
     bool always;
@@ -14,12 +14,14 @@ private:
     std::string sa1DefPath{};
 
     bool patch(MemoryFile& patch_name, Rom& rom, PixiConfig& cfg, MemoryFile& binfile);
-    int run(Rom& rom, PixiConfig& cfg);
+    int remap(Rom& rom, PixiConfig& cfg);
 public:
-    MeiMei(const MeiMeiConfig& cfg, const std::string& name);
+    // has to be constructed before anything is inserted into rom
+    MeiMei(const MeiMeiConfig& cfg, Rom& rom);
     int validate(bool revert);
     bool overSize(int size);
-    int run(PixiConfig& cfg);
+    // works on the rom pixi just inserted into, before it's written, if it fails the rom is reverted to how it was loaded
+    int run(Rom& rom, PixiConfig& cfg);
     void configureSa1Def(const std::string& pathToSa1Def);
     ~MeiMei() = default;
 };
\ No newline at end of file
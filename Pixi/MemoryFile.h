@@ -44,13 +44,13 @@ public:
 		m_data.insert(m_data.cbegin(), string.begin(), string.end());
 	}
 
-	void insertBytes(uint8_t* data, size_t length) {
+	void insertBytes(const uint8_t* data, size_t length) {
 		type = DataType::Byte;
 		m_data.reserve(length);
 		m_data.insert(m_data.end(), &data[0], &data[length]);
 	}
 
-	void insertBytes(char* data, size_t length) {
+	void insertBytes(const char* data, size_t length) {
 		type = DataType::Byte;
 		m_data.reserve(length);
 		m_data.insert(m_data.end(), &data[0], &data[length]);
@@ -66,6 +66,23 @@ public:
 		fclose(file);
 	}
 
+	// only touches the file on disk if the content changed, so its modification time stays the same otherwise
+	// the new content is written to a temporary file first and then renamed over the old one
+	bool WriteIfChanged() {
+		const bool text = type == DataType::Char;
+		if (file_content_equals(m_path, text ? "r" : "rb", m_data.data(), m_data.size()))
+			return false;
+		std::string tmp_path = m_path + ".tmp";
+		FILE* file = fileopen(tmp_path.c_str(), text ? "w" : "wb");
+		fwrite(m_data.data(), sizeof(char), m_data.size(), file);
+		fclose(file);
+		std::error_code ec{};
+		std::filesystem::rename(tmp_path, m_path, ec);
+		if (ec)
+			ErrorState::pixi_error("Couldn't replace file {}: {}\n", m_path, ec.message());
+		return true;
+	}
+
 	~MemoryFile() {
 		if (GlobalKeepFlag && m_path.length() > 0 && m_data.size() > 0 && meimeiKeep) {
 			FILE* file = nullptr;
@@ -91,6 +108,7 @@ enum class SpriteFile {
 	Extendedptr,
 	Extendedcapeptr,
 	Customsize,
+	Routinehashes,
 	SIZE
 };
 
@@ -107,6 +125,7 @@ class SpriteMemoryFiles {
 	MemoryFile extendedptr;
 	MemoryFile extendedcapeptr;
 	MemoryFile customsize;
+	MemoryFile routinehashes;
 
 	std::array<MemoryFile*, FromEnum(SpriteFile::SIZE)> files{
 		&version,
@@ -120,6 +139,7 @@ class SpriteMemoryFiles {
 		&extendedptr,
 		&extendedcapeptr,
 		&customsize,
+		&routinehashes,
 	};
 public:
 	SpriteMemoryFiles() = default;
@@ -137,6 +157,7 @@ public:
 		extendedptr.SetPath(m_path + "_ExtendedPtr.bin");
 		extendedcapeptr.SetPath(m_path + "_ExtendedCapePtr.bin");
 		customsize.SetPath(m_path + "_CustomSize.bin");
+		routinehashes.SetPath(m_path + "_RoutineHashes.bin");
 	}
 
 	constexpr MemoryFile& operator[](SpriteFile index) {
@@ -1,29 +1,47 @@
 ﻿#include "Pixi.h"
+#include "Digest.h"
 
-int main(int argc, char* argv[]) {
-	if (argc < 2)
-		wait_before_exit(argc);
-	if (!ErrorState::asar_init_wrap())
-		ErrorState::pixi_error("Asar library is missing or couldn't be initialized, please redownload the tool or the dll.\n");
-	PixiConfig cfg{ argc, argv };
-	MeiMei meimei{ cfg.m_meimei, cfg.RomName };
-	Rom rom{ cfg.RomName };
-	rom.run_checks();
-	cfg.correct_paths();
-	auto extraDefines = cfg.list_extra_asm("/ExtraDefines");
-	SpritesData sprdata{ rom, cfg };
-	sprdata.populate(cfg);
-	rom.clean(cfg);
-	cfg.create_config_file(rom.config_patch());
-	cfg.create_shared_patch(rom.shared_patch());
-	sprdata.patch_sprites_wrap(extraDefines, cfg);
-	cfg.emit_warnings();
-	DEBUGMSG("Sprites successfully patched.\n");
-	sprdata.serialize(cfg, rom.main_memory_files());
+static void notify_lunar_magic([[maybe_unused]] const PixiConfig& cfg) {
+#ifdef WIN32
+	if (!cfg.lm_handle.empty()) {
+		uint32_t IParam = (cfg.verification_code << 16) + 2;
+		PostMessage(cfg.window_handle, 0xBECB, 0, IParam);
+	}
+#endif
+}
+
+// true when the previous insertion already left the rom as this one would
+static bool skip_insertion(const PixiConfig& cfg, uint64_t inputs) {
+	if (!insertion_up_to_date(cfg, inputs))
+		return false;
+	fmt::print("Nothing changed since the last insertion into {}, skipping it (delete {} to force a full run)\n", cfg.RomName,
+		subfile_name(cfg.RomName, "pixi"));
+	notify_lunar_magic(cfg);
+	return true;
+}
+
+// main.asm, cluster.asm, extended.asm and the ExtraHijacks, in one assembly when they allow it
+static void patch_main_files(PixiConfig& cfg, Rom& rom) {
+	auto extraHijacks = cfg.list_extra_asm("/ExtraHijacks");
+	if (rom.patch_main_pass(extraHijacks, cfg)) {
+		if (extraHijacks.size() > 0 && cfg.Debug) {
+			fmt::print("-------- ExtraHijacks prints --------\n");
+			int print_count = 0;
+			auto prints = asar_getprints(&print_count);
+			const std::string* patch = nullptr;
+			for (int i = 0; i < print_count; i++) {
+				std::string_view print = prints[i];
+				if (print.rfind(Rom::hijack_print_marker, 0) == 0)
+					patch = &extraHijacks[std::stoul(std::string{ print.substr(Rom::hijack_print_marker.size()) })];
+				else if (patch != nullptr)
+					fmt::print("\tFrom file \"{}\": {}\n", *patch, print);
+			}
+		}
+		return;
+	}
 	rom.patch_main(cfg.m_Paths[PathType::Asm], "main.asm", cfg);
 	rom.patch_main(cfg.m_Paths[PathType::Asm], "cluster.asm", cfg);
 	rom.patch_main(cfg.m_Paths[PathType::Asm], "extended.asm", cfg);
-	auto extraHijacks = cfg.list_extra_asm("/ExtraHijacks");
 	if (extraHijacks.size() > 0 && cfg.Debug) {
 		fmt::print("-------- ExtraHijacks prints --------\n");
 	}
@@ -36,21 +54,81 @@ int main(int argc, char* argv[]) {
 				fmt::print("\tFrom file \"{}\": {}\n", patch, prints[i]);
 		}
 		});
+}
+
+static int insert_into_rom(PixiConfig& cfg, MeiMei& meimei, Rom& rom, SpritesData& sprdata, const std::vector<std::string>& extraDefines, uint64_t inputs) {
+	sprdata.set_rom(rom);
+	if (cfg.Output == RomOutput::Bps)
+		rom.record_source();
+	rom.clean(cfg);
+	if (cfg.FastRom && !rom.fastrom(cfg))
+		fmt::print("-fastrom was given but {} isn't a LoROM rom with the FastROM bit set in its header, the pointers stay in the slow banks\n", cfg.RomName);
+	cfg.create_config_file(rom.config_patch(), rom.fastrom(cfg));
+	cfg.create_shared_patch(rom.shared_patch(), rom.shared_routines(), find_used_routines(sprdata.source_files(extraDefines), rom.shared_routines()));
+	sprdata.patch_sprites_wrap(extraDefines, cfg);
+	rom.finish_routines(cfg);
+	cfg.emit_warnings();
+	DEBUGMSG("Sprites successfully patched.\n");
+	sprdata.serialize(cfg, rom.main_memory_files());
+	patch_main_files(cfg, rom);
 	fmt::print("\nAll sprites applied successfully\n");
 	if (cfg.ExtMod)
 		cfg.create_lm_restore();
-	rom.close();
-	ErrorState::asar_close_wrap();
 	int retval = 0;
 	if (!cfg.DisableMeiMei) {
 		meimei.configureSa1Def(cfg.AsmDirPath + "/sa1def.asm");
-		retval = meimei.run(cfg);
+		retval = meimei.run(rom, cfg);
 	}
-#ifdef WIN32
-	if (!cfg.lm_handle.empty()) {
-		uint32_t IParam = (cfg.verification_code << 16) + 2;
-		PostMessage(cfg.window_handle, 0xBECB, 0, IParam);
-	}
-#endif
+	if (retval == 0 && cfg.CostReport)
+		write_cost_report(cfg, rom, sprdata);
+	// a reverted rom is the same as the one on disk, there's nothing to put in a patch
+	if (retval == 0 || cfg.Output == RomOutput::Rom)
+		rom.close(cfg);
+	if (retval == 0 && cfg.Output == RomOutput::Rom && !rom.in_memory())
+		record_insertion(cfg, inputs);
+	ErrorState::asar_close_wrap();
+	notify_lunar_magic(cfg);
 	return retval;
 }
+
+int run_pixi(PixiConfig& cfg) {
+	if (cfg.Help)
+		return 0;
+	cfg.correct_paths();
+	uint64_t inputs = inputs_digest(cfg);
+	if (skip_insertion(cfg, inputs))
+		return 0;
+	if (!ErrorState::asar_init_wrap())
+		ErrorState::pixi_error("Asar library is missing or couldn't be initialized, please redownload the tool or the dll.\n");
+	Rom rom{ cfg.RomName };
+	MeiMei meimei{ cfg.m_meimei, rom };
+	rom.run_checks();
+	auto extraDefines = cfg.list_extra_asm("/ExtraDefines");
+	SpritesData sprdata{ rom, cfg };
+	sprdata.populate(cfg);
+	return insert_into_rom(cfg, meimei, rom, sprdata, extraDefines, inputs);
+}
+
+int run_pixi_parsed(PixiConfig& cfg, SpritesData& sprdata, const std::vector<std::string>& extraDefines) {
+	if (cfg.Help)
+		return 0;
+	uint64_t inputs = inputs_digest(cfg);
+	if (skip_insertion(cfg, inputs))
+		return 0;
+	Rom rom{ cfg.RomName };
+	MeiMei meimei{ cfg.m_meimei, rom };
+	rom.run_checks();
+	return insert_into_rom(cfg, meimei, rom, sprdata, extraDefines, inputs);
+}
+
+int run_pixi_loaded(PixiConfig& cfg, Rom& rom, SpritesData& sprdata, const std::vector<std::string>& extraDefines) {
+	if (cfg.Help)
+		return 0;
+	// a rom in memory has no file the previous insertion could be compared with
+	uint64_t inputs = rom.in_memory() ? 0 : inputs_digest(cfg);
+	if (!rom.in_memory() && skip_insertion(cfg, inputs))
+		return 0;
+	MeiMei meimei{ cfg.m_meimei, rom };
+	rom.run_checks();
+	return insert_into_rom(cfg, meimei, rom, sprdata, extraDefines, inputs);
+}
\ No newline at end of file
@@ -1,2 +1,19 @@
 ﻿#pragma once
-#include "SpritesData.h"
\ No newline at end of file
+#include "SpritesData.h"
+#include "Server.h"
+#include "Watch.h"
+#include "Batch.h"
+#include "Bench.h"
+#include "Cost.h"
+
+// runs a full insertion with an already parsed configuration, asar is initialized if it's needed
+// nothing is done when the rom and every input are the same as after the previous insertion (see Digest.h)
+int run_pixi(PixiConfig& cfg);
+
+// same as run_pixi, but the paths have already been corrected and sprdata populated from the list
+// sprdata is modified by the insertion, so it can only be used once (--batch forks before calling this)
+int run_pixi_parsed(PixiConfig& cfg, SpritesData& sprdata, const std::vector<std::string>& extraDefines);
+
+// same as run_pixi_parsed, but the rom is already loaded too, it can only be used once as well
+// a rom in memory (see Rom::in_memory) is always inserted into and no insertion is recorded for it
+int run_pixi_loaded(PixiConfig& cfg, Rom& rom, SpritesData& sprdata, const std::vector<std::string>& extraDefines);
\ No newline at end of file
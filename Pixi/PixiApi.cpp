@@ -0,0 +1,143 @@
+#include "Pixi.h"
+#include "PixiApi.h"
+
+struct pixi_session {
+	std::string pixi_exe{};
+	std::string last_error{};
+	pixi_message_callback callback = nullptr;
+	void* user_data = nullptr;
+};
+
+static int open_sessions = 0;
+
+static void forward_message(MessageKind kind, const char* message, void* user_data) {
+	pixi_session* session = static_cast<pixi_session*>(user_data);
+	if (kind == MessageKind::Error)
+		session->last_error = message;
+	if (session->callback != nullptr)
+		session->callback(kind == MessageKind::Error ? PIXI_MESSAGE_ERROR : PIXI_MESSAGE_WARNING, message, session->user_data);
+}
+
+static bool valid_args(int argc, const char* const* argv) {
+	if (argc < 1 || argv == nullptr)
+		return false;
+	for (int i = 0; i < argc; i++) {
+		if (argv[i] == nullptr)
+			return false;
+		std::string_view arg{ argv[i] };
+		// these aren't an insertion at all
+		if (arg == "-h" || arg == "--help" || arg == "--serve" || arg == "--client" || arg == "--watch")
+			return false;
+	}
+	return true;
+}
+
+template <typename Insertion>
+static pixi_status run_insertion(pixi_session* session, int argc, const char* const* argv, Insertion insertion) {
+	std::vector<char*> args{};
+	args.push_back(const_cast<char*>(session->pixi_exe.c_str()));
+	for (int i = 0; i < argc; i++)
+		args.push_back(const_cast<char*>(argv[i]));
+
+	ErrorState::message_handler = forward_message;
+	ErrorState::message_user_data = session;
+	pixi_status status = PIXI_OK;
+	try {
+		PixiConfig cfg{ (int)args.size(), args.data() };
+		if (insertion(cfg) != 0) {
+			session->last_error = "MeiMei failed to remap the sprite data, the rom has been reverted";
+			status = PIXI_ERROR;
+		}
+	}
+	catch (const std::exception& e) {
+		session->last_error = e.what();
+		status = PIXI_ERROR;
+	}
+	ErrorState::message_handler = nullptr;
+	ErrorState::message_user_data = nullptr;
+	fflush(stdout);
+	return status;
+}
+
+extern "C" {
+
+int pixi_api_version(void) {
+	return PIXI_API_VERSION;
+}
+
+pixi_status pixi_session_create(const char* pixi_dir, pixi_session** session) {
+	if (session == nullptr)
+		return PIXI_INVALID_ARGUMENT;
+	*session = nullptr;
+	if (pixi_dir == nullptr)
+		return PIXI_INVALID_ARGUMENT;
+	if (!ErrorState::asar_init_wrap())
+		return PIXI_ASAR_UNAVAILABLE;
+	ErrorState::keep_asar_loaded = true;
+	open_sessions++;
+	*session = new pixi_session{};
+	// paths are resolved relative to the folder of the executable, so pretend there's one in pixi_dir
+	(*session)->pixi_exe = (std::filesystem::absolute(pixi_dir) / "pixi").generic_string();
+	return PIXI_OK;
+}
+
+void pixi_session_destroy(pixi_session* session) {
+	if (session == nullptr)
+		return;
+	delete session;
+	if (--open_sessions == 0) {
+		ErrorState::keep_asar_loaded = false;
+		ErrorState::asar_close_wrap();
+	}
+}
+
+void pixi_session_set_callback(pixi_session* session, pixi_message_callback callback, void* user_data) {
+	if (session == nullptr)
+		return;
+	session->callback = callback;
+	session->user_data = user_data;
+}
+
+pixi_status pixi_insert(pixi_session* session, int argc, const char* const* argv) {
+	if (session == nullptr)
+		return PIXI_INVALID_ARGUMENT;
+	session->last_error.clear();
+	if (!valid_args(argc, argv)) {
+		session->last_error = "Invalid arguments";
+		return PIXI_INVALID_ARGUMENT;
+	}
+	return run_insertion(session, argc, argv, [](PixiConfig& cfg) { return run_pixi(cfg); });
+}
+
+pixi_status pixi_insert_buffer(pixi_session* session, int argc, const char* const* argv,
+	unsigned char* rom, size_t* rom_size, size_t rom_capacity) {
+	if (session == nullptr)
+		return PIXI_INVALID_ARGUMENT;
+	session->last_error.clear();
+	if (!valid_args(argc, argv) || rom == nullptr || rom_size == nullptr || *rom_size > rom_capacity) {
+		session->last_error = "Invalid arguments";
+		return PIXI_INVALID_ARGUMENT;
+	}
+	pixi_status status = run_insertion(session, argc, argv, [&](PixiConfig& cfg) {
+		if (cfg.Help)
+			return 0;
+		cfg.correct_paths();
+		Rom buffer_rom{ cfg.RomName, RomBuffer{ rom, rom_size, rom_capacity } };
+		auto extraDefines = cfg.list_extra_asm("/ExtraDefines");
+		SpritesData sprdata{ buffer_rom, cfg };
+		sprdata.populate(cfg);
+		return run_pixi_loaded(cfg, buffer_rom, sprdata, extraDefines);
+	});
+	// close sets the size the rom needs when it doesn't fit, the buffer is left as it was
+	if (status == PIXI_ERROR && *rom_size > rom_capacity)
+		return PIXI_BUFFER_TOO_SMALL;
+	return status;
+}
+
+const char* pixi_last_error(const pixi_session* session) {
+	if (session == nullptr)
+		return "";
+	return session->last_error.c_str();
+}
+
+}
\ No newline at end of file
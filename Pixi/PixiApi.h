@@ -0,0 +1,76 @@
+#pragma once
+/*
+	C interface of libpixi, for tools that want to insert sprites without running the executable.
+
+	A session keeps asar loaded between insertions, errors never terminate the host process:
+	every call returns a pixi_status and the message of the last error is kept in the session.
+	Sessions aren't thread safe and only one insertion can run at a time in the whole process,
+	since asar itself is a single global instance.
+
+	Regular progress output (the same as the executable prints) still goes to stdout,
+	errors and warnings go to the message callback when one is set.
+*/
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#	if defined(PIXI_BUILDING_LIBRARY)
+#		define PIXI_API __declspec(dllexport)
+#	else
+#		define PIXI_API __declspec(dllimport)
+#	endif
+#else
+#	define PIXI_API __attribute__((visibility("default")))
+#endif
+
+#define PIXI_API_VERSION 1
+
+typedef struct pixi_session pixi_session;
+
+typedef enum pixi_status {
+	PIXI_OK = 0,
+	// the insertion failed, pixi_last_error has the reason
+	PIXI_ERROR = 1,
+	PIXI_INVALID_ARGUMENT = 2,
+	// asar couldn't be loaded
+	PIXI_ASAR_UNAVAILABLE = 3,
+	// the rom grew past the capacity of the buffer passed to pixi_insert_buffer
+	PIXI_BUFFER_TOO_SMALL = 4
+} pixi_status;
+
+typedef enum pixi_message_kind {
+	PIXI_MESSAGE_ERROR = 0,
+	PIXI_MESSAGE_WARNING = 1
+} pixi_message_kind;
+
+typedef void (*pixi_message_callback)(pixi_message_kind kind, const char* message, void* user_data);
+
+PIXI_API int pixi_api_version(void);
+
+// pixi_dir is the folder that contains asm/, routines/, sprites/ etc. (what would be the folder of the executable)
+// on PIXI_OK *session is the new session, otherwise it's set to NULL:
+// PIXI_INVALID_ARGUMENT when pixi_dir or session is NULL, PIXI_ASAR_UNAVAILABLE when asar can't be loaded
+PIXI_API pixi_status pixi_session_create(const char* pixi_dir, pixi_session** session);
+PIXI_API void pixi_session_destroy(pixi_session* session);
+PIXI_API void pixi_session_set_callback(pixi_session* session, pixi_message_callback callback, void* user_data);
+
+// argv holds the same options as the command line followed by the rom path, without the program name
+PIXI_API pixi_status pixi_insert(pixi_session* session, int argc, const char* const* argv);
+
+// same as pixi_insert, but the rom content comes from the buffer and the result is written back to it
+// the rom path (last element of argv) is still used to find the list file and to name the .ssc/.mwt/.mw2/.s16 files,
+// the rom file itself is neither read nor written (with -ips or -bps the patch is written next to it, the buffer is left as it is)
+// rom_size is updated with the new size, rom_capacity is the allocated size of the buffer
+// PIXI_BUFFER_TOO_SMALL leaves the buffer untouched and sets rom_size to the capacity it needs
+PIXI_API pixi_status pixi_insert_buffer(pixi_session* session, int argc, const char* const* argv,
+	unsigned char* rom, size_t* rom_size, size_t rom_capacity);
+
+// message of the last error of the session, empty string if there wasn't one
+PIXI_API const char* pixi_last_error(const pixi_session* session);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
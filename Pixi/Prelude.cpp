@@ -0,0 +1,119 @@
+#include "Prelude.h"
+#include <map>
+
+static constexpr std::array<std::string_view, 8> mapper_commands{ "lorom", "hirom", "exlorom", "exhirom", "sa1rom", "fullsa1rom", "sfxrom", "norom" };
+
+static std::vector<std::string> split_statements(const std::string& line) {
+	std::vector<std::string> statements{};
+	size_t start = 0;
+	for (size_t sep = line.find(" : "); sep != std::string::npos; sep = line.find(" : ", start)) {
+		statements.push_back(line.substr(start, sep - start));
+		start = sep + 3;
+	}
+	statements.push_back(line.substr(start));
+	for (std::string& statement : statements)
+		trim(statement);
+	return statements;
+}
+
+static std::string first_word(const std::string& statement) {
+	std::string word = statement.substr(0, statement.find_first_of(" \t("));
+	strtolower(word);
+	return word;
+}
+
+// setting a define or a conditional around it
+static bool only_defines(const std::string& statement) {
+	std::string command = first_word(statement);
+	return statement.empty() || (statement[0] == '!' && statement.find('=') != std::string::npos) ||
+		command == "if" || command == "elseif" || command == "else" || command == "endif";
+}
+
+struct CollectState {
+	std::string macros{};
+	std::set<std::string> visiting{};
+	// every macro seen so far, true if all it does is set defines
+	std::map<std::string, bool> define_macros{};
+};
+
+static bool collect_file(const std::filesystem::path& path, const std::set<std::string>& generated, int if_depth, CollectState& state) {
+	std::ifstream file{ path };
+	if (!file || !state.visiting.insert(path.string()).second)
+		return false;
+	std::string macro{};
+	std::string line{};
+	while (std::getline(file, line)) {
+		std::string code = line.substr(0, line.find(';'));
+		trim(code);
+		std::string lower = code;
+		strtolower(lower);
+		if (!macro.empty()) {
+			state.macros += line + '\n';
+			if (lower.compare(0, 8, "endmacro") == 0) {
+				macro.clear();
+				continue;
+			}
+			for (const std::string& statement : split_statements(code))
+				state.define_macros[macro] = state.define_macros[macro] && only_defines(statement);
+			continue;
+		}
+		if (lower.compare(0, 6, "macro ") == 0) {
+			// a macro that's only declared sometimes can't be moved out of its if
+			if (if_depth > 0)
+				return false;
+			state.macros += line + '\n';
+			macro = code.substr(6, code.find('(') - 6);
+			trim(macro);
+			state.define_macros[macro] = true;
+			continue;
+		}
+		for (const std::string& statement : split_statements(code)) {
+			std::string command = first_word(statement);
+			if (statement.empty() || statement[0] == '@')
+				continue;
+			if (statement[0] == '!' && statement.find('=') != std::string::npos)
+				continue;
+			// calling a macro that only sets defines is the same as setting them
+			if (statement[0] == '%') {
+				auto called = state.define_macros.find(statement.substr(1, statement.find('(') - 1));
+				if (called == state.define_macros.end() || !called->second)
+					return false;
+				continue;
+			}
+			if (command == "if")
+				if_depth++;
+			else if (command == "endif")
+				if_depth--;
+			else if (command == "else" || command == "elseif" || command == "includeonce")
+				continue;
+			else if (std::find(mapper_commands.begin(), mapper_commands.end(), command) != mapper_commands.end())
+				continue;
+			else if (command == "incsrc") {
+				std::string include = statement.substr(6);
+				trim(include);
+				if (include.size() >= 2 && include.front() == '"' && include.back() == '"')
+					include = include.substr(1, include.size() - 2);
+				if (include.empty() || include.find_first_of("!<") != std::string::npos)
+					return false;
+				std::filesystem::path included = (path.parent_path() / include).lexically_normal();
+				if (generated.count(included.generic_string()))
+					continue;
+				if (!collect_file(included, generated, if_depth, state))
+					return false;
+			}
+			else
+				return false;
+		}
+	}
+	state.visiting.erase(path.string());
+	return macro.empty();
+}
+
+std::optional<std::string> collect_macros(const std::vector<std::string>& files, const std::set<std::string>& generated) {
+	CollectState state{};
+	for (const std::string& file : files) {
+		if (!collect_file(std::filesystem::path{ file }.lexically_normal(), generated, 0, state))
+			return std::nullopt;
+	}
+	return state.macros;
+}
\ No newline at end of file
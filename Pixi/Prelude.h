@@ -0,0 +1,10 @@
+#pragma once
+#include "Config.h"
+
+// every sprite is assembled after sa1def.asm (with config.asm), shared.asm and the _header.asm of its folder.
+// when those only set defines and declare macros, they're assembled once per folder instead: the sprites get the
+// resulting defines as additional defines and only the text of the macros, see Rom::sprite_prelude.
+
+// the macros declared in files (and what they incsrc, except the files in generated) in order,
+// nothing if any of them does something else than setting defines, declaring macros or choosing the mapper
+std::optional<std::string> collect_macros(const std::vector<std::string>& files, const std::set<std::string>& generated);
\ No newline at end of file
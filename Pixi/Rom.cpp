@@ -1,10 +1,26 @@
 #include "Rom.h"
+#include "Prelude.h"
+#include <charconv>
 
 Rom::Rom(std::string romname) : m_name(romname)
 {
-	m_data.from_file(fileopen(romname.c_str(), "rb"));
+	FILE* fp = fileopen(romname.c_str(), "rb");
+	m_data.from_file(fp);
+	fclose(fp);
+	init();
+}
+
+Rom::Rom(std::string romname, RomBuffer buffer) : m_name(romname), m_buffer(buffer)
+{
+	m_data.from_buffer(buffer.data, *buffer.size);
+	init();
+}
+
+void Rom::init()
+{
 	m_header_offset = m_data.size() & 0x7FFF;
 	m_size = m_data.size() - m_header_offset;
+	m_source_size = m_data.size();
 	if (data()[0x7fd5] == 0x23) {
 		if (data()[0x7fd7] == 0x0D) {
 			m_mapper = MapperType::FullSA1Rom;
@@ -17,6 +33,7 @@ Rom::Rom(std::string romname) : m_name(romname)
 		m_mapper = MapperType::LoRom;
 	}
 	m_sprite_patch.insertChar(sprite_asm_patch);
+	m_sprite_prelude_patch.insertChar(sprite_prelude_asm_patch);
 	DEBUGFMTMSG("Correctly instantiated rom \"{}\" with mapper {} and header offset {:X}\n", m_name, MapperToString(m_mapper), m_header_offset);
 }
 
@@ -24,37 +41,214 @@ Rom& Rom::operator=(Rom&& other) noexcept
 {
 	m_data = std::move(other.m_data);
 	m_name = std::move(other.m_name);
+	m_buffer = other.m_buffer;
 	m_header_offset = other.m_header_offset;
 	m_mapper = other.m_mapper;
 	m_size = other.m_size;
+	m_written = std::move(other.m_written);
+	m_source_size = other.m_source_size;
+	m_source_crc = other.m_source_crc;
+	m_original = std::move(other.m_original);
+	m_journal = std::move(other.m_journal);
+	m_routines = std::move(other.m_routines);
+	m_retained_routines = std::move(other.m_retained_routines);
+	m_used_routines = std::move(other.m_used_routines);
+	m_preludes = std::move(other.m_preludes);
+	m_cleanup = std::move(other.m_cleanup);
+	m_first_patch = std::move(other.m_first_patch);
+	m_last_blocks = std::move(other.m_last_blocks);
+	m_sprite_blocks = std::move(other.m_sprite_blocks);
+	m_rats_tags = std::move(other.m_rats_tags);
 	return *this;
 }
 
-constexpr MapperType Rom::mapper()
-{
-	return m_mapper;
-}
-
 // returns a read only view of the headerless data of the rom
 const ByteArrayView<uint8_t> Rom::data()
 {
 	return ByteArrayView(m_data, m_header_offset);
 }
 
+void Rom::record_source() {
+	m_source_size = m_data.size();
+	m_source_crc = crc32(m_data.start(), m_data.size());
+}
+
+// adds [offset, offset + len) to ranges, merging it with the ranges it touches
+static void merge_range(std::map<size_t, size_t>& ranges, size_t offset, size_t len) {
+	if (len == 0)
+		return;
+	size_t start = offset;
+	size_t end = offset + len;
+	auto it = ranges.upper_bound(start);
+	if (it != ranges.begin()) {
+		auto before = std::prev(it);
+		if (before->second >= start) {
+			start = before->first;
+			end = std::max(end, before->second);
+			it = ranges.erase(before);
+		}
+	}
+	while (it != ranges.end() && it->first <= end) {
+		end = std::max(end, it->second);
+		it = ranges.erase(it);
+	}
+	ranges.emplace(start, end);
+}
+
+void Rom::mark_written(size_t offset, size_t len) {
+	merge_range(m_written, offset, len);
+}
+
+void Rom::save_original(size_t offset, size_t len, bool from_file) {
+	size_t pos = offset;
+	const size_t end = offset + len;
+	auto it = m_original.upper_bound(pos);
+	if (it != m_original.begin()) {
+		auto before = std::prev(it);
+		pos = std::max(pos, before->first + before->second.size());
+	}
+	FILE* fp = nullptr;
+	while (pos < end) {
+		size_t gap_end = it == m_original.end() ? end : std::min(end, it->first);
+		if (pos < gap_end) {
+			// past the end of the file the loaded content is 0
+			std::vector<uint8_t> original(gap_end - pos, 0);
+			if (from_file && m_buffer) {
+				if (pos < m_source_size)
+					memcpy(original.data(), m_buffer->data + pos, std::min(gap_end, m_source_size) - pos);
+			}
+			else if (from_file) {
+				if (fp == nullptr)
+					fp = fileopen(m_name.c_str(), "rb");
+				if (fseek(fp, (long)pos, SEEK_SET) == 0)
+					fread(original.data(), sizeof(uint8_t), original.size(), fp);
+			}
+			else {
+				memcpy(original.data(), m_data.ptr_at(pos), original.size());
+			}
+			m_original.emplace_hint(it, pos, std::move(original));
+		}
+		if (it == m_original.end())
+			break;
+		pos = std::max(gap_end, it->first + it->second.size());
+		++it;
+	}
+	if (fp != nullptr)
+		fclose(fp);
+}
+
+void Rom::journal(size_t offset, size_t len) {
+	if (len == 0)
+		return;
+	m_journal.push_back({ offset, std::vector<uint8_t>(m_data.ptr_at(offset), m_data.ptr_at(offset + len)) });
+	mark_written(offset, len);
+}
+
+void Rom::track_written_blocks() {
+	int block_count = 0;
+	auto blocks = asar_getwrittenblocks(&block_count);
+	m_last_blocks.clear();
+	for (int i = 0; i < block_count; i++) {
+		save_original(m_header_offset + blocks[i].pcoffset, blocks[i].numbytes, true);
+		journal(m_header_offset + blocks[i].pcoffset, blocks[i].numbytes);
+		m_last_blocks.push_back({ blocks[i].snesoffset, blocks[i].pcoffset, blocks[i].numbytes });
+	}
+	track_cleaned_blocks();
+	m_cleanup.clear();
+}
+
+// "STAR", the size of the protected data minus 1 and its complement
+static std::optional<size_t> rats_tag_size(const uint8_t* tag) {
+	if (memcmp(tag, "STAR", 4) != 0)
+		return std::nullopt;
+	size_t size = tag[4] | (tag[5] << 8);
+	size_t inverse = tag[6] | (tag[7] << 8);
+	if ((size ^ inverse) != 0xFFFF)
+		return std::nullopt;
+	return 8 + size + 1;
+}
+
+void Rom::find_rats_tags() {
+	m_rats_tags.clear();
+	const size_t end = m_header_offset + m_size;
+	for (size_t pc = m_header_offset; pc + 8 <= end; pc++) {
+		auto size = rats_tag_size(m_data.ptr_at(pc));
+		if (!size || pc + *size > end)
+			continue;
+		m_rats_tags.emplace(pc, *size);
+		// what a tag protects can't hold another one
+		pc += *size - 1;
+	}
+}
+
+void Rom::track_cleaned_blocks() {
+	for (auto it = m_rats_tags.begin(); it != m_rats_tags.end();) {
+		if (rats_tag_size(m_data.ptr_at(it->first)) == it->second) {
+			++it;
+			continue;
+		}
+		// the file still has what the block had when it was loaded, which rolling back puts back
+		save_original(it->first, it->second, true);
+		journal(it->first, it->second);
+		it = m_rats_tags.erase(it);
+	}
+}
+
+const MemoryFile& Rom::with_cleanup(const MemoryFile& patch) {
+	if (m_cleanup.empty())
+		return patch;
+	// same path, so that the files it includes are found the same way
+	m_first_patch = std::make_unique<MemoryFile>(std::string{ patch.Path() }, false);
+	m_first_patch->insertString("{}\n{}", m_cleanup, std::string_view{ (const char*)patch.Data(), patch.Size() });
+	return *m_first_patch;
+}
+
+void Rom::rollback(const Checkpoint& cp) {
+	std::map<size_t, size_t> touched{};
+	for (size_t i = cp.entries; i < m_journal.size(); i++)
+		merge_range(touched, m_journal[i].offset, m_journal[i].data.size());
+	auto copy_overlap = [this](size_t start, size_t end, size_t offset, const std::vector<uint8_t>& data) {
+		size_t from = std::max(start, offset);
+		size_t to = std::min(end, offset + data.size());
+		if (from < to)
+			memcpy(m_data.ptr_at(from), data.data() + (from - offset), to - from);
+	};
+	// back to the loaded content first, then every write up to the checkpoint is applied again
+	for (auto [start, end] : touched) {
+		auto it = m_original.upper_bound(start);
+		if (it != m_original.begin())
+			--it;
+		for (; it != m_original.end() && it->first < end; ++it)
+			copy_overlap(start, end, it->first, it->second);
+	}
+	for (size_t i = 0; i < cp.entries; i++) {
+		const JournalEntry& entry = m_journal[i];
+		auto it = touched.upper_bound(entry.offset);
+		if (it != touched.begin())
+			--it;
+		for (; it != touched.end() && it->first < entry.offset + entry.data.size(); ++it)
+			copy_overlap(it->first, it->second, entry.offset, entry.data);
+	}
+	m_journal.erase(m_journal.begin() + cp.entries, m_journal.end());
+	m_size = cp.size;
+}
+
 void Rom::write(size_t offset, const uint8_t* data, size_t len) {
+	save_original(offset, len, false);
 	m_data.write_at(data, len, offset);
+	journal(offset, len);
 }
 
 void Rom::write(size_t offset, const std::vector<uint8_t>& data) {
-	m_data.write_at(data.data(), data.size(), offset);
+	write(offset, data.data(), data.size());
 }
 
 void Rom::write_snes(size_t address, const uint8_t* data, size_t len) {
-	m_data.write_at(data, len, snes_to_pc(address));
+	write(snes_to_pc(address), data, len);
 }
 
 void Rom::write_snes(size_t address, const std::vector<uint8_t>& data) {
-	m_data.write_at(data.data(), data.size(), snes_to_pc(address));
+	write(snes_to_pc(address), data.data(), data.size());
 }
 
 uint8_t Rom::at(size_t offset)
@@ -152,16 +346,67 @@ size_t Rom::snes_to_pc(size_t address, bool header) {
 	return address + (header ? m_header_offset : 0);
 }
 
+// what a routine's code depends on besides its source
+static uint64_t routine_context(PixiConfig& cfg, MapperType mapper, bool fastrom) {
+	uint64_t hash = fnv1a_hash(nullptr, 0);
+	std::string flags = fmt::format("{} {} {} {} {}", PixiConfig::VERSION, FromEnum(mapper), cfg.PerLevel, cfg.disable255Sprites, fastrom);
+	hash = fnv1a_hash(flags.data(), flags.size(), hash);
+	std::vector<std::string> files = cfg.list_extra_asm("/ExtraDefines");
+	files.push_back(cfg.AsmDirPath + "/sa1def.asm");
+	for (const std::string& file : files) {
+		uint64_t content = file_hash(file).value_or(0);
+		hash = fnv1a_hash(file.data(), file.size(), hash);
+		hash = fnv1a_hash(&content, sizeof(content), hash);
+	}
+	return hash;
+}
+
+std::vector<uint64_t> Rom::inserted_routine_hashes()
+{
+	std::vector<uint64_t> hashes(ROUTINE_SLOTS, 0);
+	int table = pointer_snes(ROUTINE_HASHES).addr();
+	if (table == 0xFFFFFF)
+		return hashes;
+	size_t offset = snes_to_pc(table);
+	if (offset == s::max() || offset + 4 + ROUTINE_SLOTS * 8 > m_data.size() || memcmp(m_data.ptr_at(offset), "RTNH", 4) != 0)
+		return hashes;
+	offset += 4;
+	for (int slot = 0; slot < ROUTINE_SLOTS; slot++) {
+		for (int i = 7; i >= 0; i--)
+			hashes[slot] = (hashes[slot] << 8) | m_data[offset + slot * 8 + i];
+	}
+	return hashes;
+}
+
 void Rom::clean(PixiConfig& cfg)
 {
+	m_routines = list_shared_routines(cfg, routine_context(cfg, m_mapper, fastrom(cfg)));
+	m_retained_routines.clear();
+	m_used_routines.clear();
 	if (!strncmp((char*)m_data.ptr_at(snes_to_pc(0x02FFE2)), "STSD", 4)) { // already installed load old tables
+		find_rats_tags();
 
 		MemoryFile clean_patch{ cfg.AsmDir + "_cleanup.asm" };
+		// sprites that share an asm file share their pointers, every block only has to be cleaned once
+		std::set<int> cleaned{};
+		auto autoclean = [&clean_patch, &cleaned](int address, std::string_view comment = {}) {
+			if (!cleaned.insert(address).second)
+				return;
+			if (comment.empty())
+				clean_patch.insertString("autoclean ${:06X}\n", address);
+			else
+				clean_patch.insertString("autoclean ${:06X}\t;{}\n", address, comment);
+		};
 
 		auto version = at(snes_to_pc(0x02FFE6));
 		auto flags = at(snes_to_pc(0x02FFE7));
 
-		bool per_level_sprites_inserted = ((flags & 0x01) == 1) || (version < 2);
+		bool per_level_sprites_inserted = ((flags & PixiConfig::FLAG_PER_LEVEL) != 0) || (version < 2);
+		bool planar = (flags & PixiConfig::FLAG_PLANAR) != 0;
+		// the pointer at index of a cluster or extended table
+		auto table_pointer = [this, planar](int table, int index) {
+			return planar ? planar_pointer_snes(table + index, Sprite::SPRITE_COUNT) : pointer_snes(table + 3 * index);
+		};
 
 		// bit 0 = per level sprites inserted
 		if (per_level_sprites_inserted) {
@@ -186,8 +431,7 @@ void Rom::clean(PixiConfig& cfg)
 								continue;
 							}
 							if (!main_pointer.is_empty()) {
-								clean_patch.insertString("autoclean ${:06X}\t;{:03X}:{:02X}\n", main_pointer.addr(), level >> 1,
-									0xB0 + (i >> 1));
+								autoclean(main_pointer.addr(), fmt::format("{:03X}:{:02X}", level >> 1, 0xB0 + (i >> 1)));
 							}
 						}
 					}
@@ -208,7 +452,7 @@ void Rom::clean(PixiConfig& cfg)
 							break;
 						}
 						if (!main_pointer.is_empty()) {
-							clean_patch.insertString("autoclean ${:06X}\n", main_pointer.addr());
+							autoclean(main_pointer.addr());
 						}
 					}
 					clean_patch.insertString("\n");
@@ -228,11 +472,11 @@ void Rom::clean(PixiConfig& cfg)
 			for (int table_offset = 0x08; table_offset < limit; table_offset += 0x10) {
 				Pointer init_pointer = pointer_snes(global_table_address + table_offset);
 				if (!init_pointer.is_empty()) {
-					clean_patch.insertString("autoclean ${:06X}\n", init_pointer.addr());
+					autoclean(init_pointer.addr());
 				}
 				Pointer main_pointer = pointer_snes(global_table_address + table_offset + 3);
 				if (!main_pointer.is_empty()) {
-					clean_patch.insertString("autoclean ${:06X}\n", main_pointer.addr());
+					autoclean(main_pointer.addr());
 				}
 			}
 		}
@@ -242,23 +486,42 @@ void Rom::clean(PixiConfig& cfg)
 		int pointer_table_address = pointer_snes(0x02FFFD).addr();
 		if (pointer_table_address != 0xFFFFFF && pointer_snes(pointer_table_address).addr() != 0xFFFFFF) {
 			for (int table_offset = 0; table_offset < 0x100 * 15; table_offset += 3) {
-				Pointer ptr = pointer_snes(pointer_table_address + table_offset);
+				// planar, the 5 pointers of a sprite are in 0x300 byte blocks, one per status
+				Pointer ptr = planar ? planar_pointer_snes(pointer_table_address + (table_offset % 15) * 0x100 + table_offset / 15, 0x100)
+					: pointer_snes(pointer_table_address + table_offset);
 				if (!ptr.is_empty() && ptr.addr() != 0) {
-					clean_patch.insertString("autoclean ${:06X}\n", ptr.addr());
+					autoclean(ptr.addr());
 				}
 			}
 		}
 
-		// shared routines
+		// shared routines, the code of the ones that are the same as when they were inserted stays where it is
+		// the pointer table is written here and not by the patch: the sprites read it with read3(), which sees
+		// the rom as it was before the assembly started
 		clean_patch.insertString("\n\n;Routines:\n");
-		for (int i = 0; i < 100; i++) {
-			int routine_pointer = pointer_snes(0x03E05C + i * 3).addr();
+		std::vector<uint64_t> inserted_hashes = inserted_routine_hashes();
+		const std::vector<uint8_t> empty_slot{ 0xFF, 0xFF, 0xFF };
+		for (int i = 0; i < cfg.Routines; i++) {
+			int routine_pointer = pointer_snes(ROUTINE_POINTERS + i * 3).addr();
 			if (routine_pointer != 0xFFFFFF) {
-				clean_patch.insertString("autoclean ${:06X}\n", routine_pointer);
-				clean_patch.insertString("\torg ${:06X}\n", 0x03E05C + i * 3);
-				clean_patch.insertString("\tdl $FFFFFF\n");
+				auto same = std::find_if(m_routines.begin(), m_routines.end(), [hash = inserted_hashes[i]](const SharedRoutine& routine) {
+					return hash != 0 && routine.hash == hash;
+				});
+				if (same != m_routines.end())
+					m_retained_routines.emplace(same->name, routine_pointer);
+				else
+					autoclean(routine_pointer);
+				write_snes(ROUTINE_POINTERS + i * 3, empty_slot);
 			}
 		}
+		// the slot of a kept routine can change when routines are added or removed
+		for (const SharedRoutine& routine : m_routines) {
+			auto retained = m_retained_routines.find(routine.name);
+			if (retained == m_retained_routines.end())
+				continue;
+			clean_patch.insertString(";{} kept at ${:06X}\n", routine.name, retained->second);
+			write_snes(ROUTINE_POINTERS + routine.slot * 3, { (uint8_t)retained->second, (uint8_t)(retained->second >> 8), (uint8_t)(retained->second >> 16) });
+		}
 
 		// Version 1.01 stuff:
 		if (version >= 1) {
@@ -268,9 +531,9 @@ void Rom::clean(PixiConfig& cfg)
 			int cluster_table = pointer_snes(0x00A68A).addr();
 			if (cluster_table != 0x9C1498) // check with default/uninserted address
 				for (int i = 0; i < Sprite::SPRITE_COUNT; i++) {
-					Pointer cluster_pointer = pointer_snes(cluster_table + 3 * i);
+					Pointer cluster_pointer = table_pointer(cluster_table, i);
 					if (!cluster_pointer.is_empty())
-						clean_patch.insertString("autoclean ${:06X}\n", cluster_pointer.addr());
+						autoclean(cluster_pointer.addr());
 				}
 
 			// remove extended sprites
@@ -278,25 +541,73 @@ void Rom::clean(PixiConfig& cfg)
 			int extended_table = pointer_snes(0x029B1F).addr();
 			if (extended_table != 0x176FBC) // check with default/uninserted address
 				for (int i = 0; i < Sprite::SPRITE_COUNT; i++) {
-					Pointer extended_pointer = pointer_snes(extended_table + 3 * i);
+					Pointer extended_pointer = table_pointer(extended_table, i);
 					if (!extended_pointer.is_empty())
-						clean_patch.insertString("autoclean ${:06X}\n", extended_pointer.addr());
+						autoclean(extended_pointer.addr());
 				}
 		}
 		// everything else is being cleaned by the main patch itself.
-		patch(clean_patch, cfg);
+		// the autocleans go ahead of the first assembly of the insertion, so the space they free is already
+		// there when it looks for freespace
+		m_cleanup.assign((const char*)clean_patch.Data(), clean_patch.Size());
+		DEBUGFMTMSG("{} blocks to clean, done by the first patch\n", cleaned.size());
 	}
 	else if (!strncmp((char*)m_data.ptr_at(snes_to_pc(pointer_snes(0x02A963 + 1).addr() - 3)), "MDK", 3)) {
 		ErrorState::pixi_error("It looks like this ROM has been patched with Romi's SpriteTool, Pixi is not compatible with it, insertion aborted\n");
 	}
 }
 
+void Rom::finish_routines(PixiConfig& cfg)
+{
+	// a kept routine that's only called by other kept routines is still in use
+	std::set<std::string> used = m_used_routines;
+	add_called_routines(m_routines, used);
+	MemoryFile release_patch{ cfg.AsmDir + "_routines.asm" };
+	for (const SharedRoutine& routine : m_routines) {
+		auto retained = m_retained_routines.find(routine.name);
+		if (retained == m_retained_routines.end() || used.count(routine.name))
+			continue;
+		release_patch.insertString(";{} isn't used anymore\n", routine.name);
+		release_patch.insertString("autoclean ${:06X}\n", retained->second);
+		release_patch.insertString("\torg ${:06X}\n", ROUTINE_POINTERS + routine.slot * 3);
+		release_patch.insertString("\tdl $FFFFFF\n");
+	}
+	if (release_patch.Size() > 0)
+		patch(release_patch, cfg);
+	DEBUGFMTMSG("{} of {} inserted routines kept\n", m_retained_routines.size(), used.size());
+
+	// "RTNH" followed by the hash of the routine in every slot, 0 for empty slots
+	std::vector<uint8_t> hashes{ 'R', 'T', 'N', 'H' };
+	hashes.resize(4 + ROUTINE_SLOTS * 8, 0);
+	for (const SharedRoutine& routine : m_routines) {
+		if (routine.slot >= ROUTINE_SLOTS || pointer_snes(ROUTINE_POINTERS + routine.slot * 3).addr() == 0xFFFFFF)
+			continue;
+		for (int i = 0; i < 8; i++)
+			hashes[4 + routine.slot * 8 + i] = (uint8_t)(routine.hash >> (i * 8));
+	}
+	m_main_memory_files[SpriteFile::Routinehashes].insertBytes(hashes.data(), hashes.size());
+}
+
 void addIncSrcToFile(MemoryFile& file, const std::vector<std::string>& toInclude) {
 	for (std::string const& incPath : toInclude) {
 		file.insertString("incsrc \"{}\"\n", incPath);
 	}
 }
 
+int Rom::routine_pointer(int slot)
+{
+	if (slot >= ROUTINE_SLOTS)
+		return 0xFFFFFF;
+	return static_cast<int>(pointer_snes(ROUTINE_POINTERS + slot * 3).addr());
+}
+
+const std::vector<WrittenBlock>& Rom::sprite_blocks(const std::string& asm_file) const
+{
+	static const std::vector<WrittenBlock> none{};
+	auto blocks = m_sprite_blocks.find(asm_file);
+	return blocks == m_sprite_blocks.end() ? none : blocks->second;
+}
+
 Pointer Rom::pointer_snes(int address, int size, int bank)
 {
 	auto offset = snes_to_pc(address);
@@ -305,9 +616,16 @@ Pointer Rom::pointer_snes(int address, int size, int bank)
 	return Pointer(res);
 }
 
+Pointer Rom::planar_pointer_snes(int address, int plane)
+{
+	return Pointer(at_snes(address) | (at_snes(address + plane) << 8) | (at_snes(address + 2 * plane) << 16));
+}
+
 bool Rom::patch_simple(std::string_view path, PixiConfig& cfg)
 {
-	if (!asar_patch(path.data(), (char*)m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, &size())) {
+	StructParams paramsWrap{};
+	auto params = paramsWrap.construct(path, m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
+	if (!asar_patch_ex(params)) {
 		DEBUGMSG("Failure. Try fetch errors:\n");
 		int error_count;
 		auto errors = asar_geterrors(&error_count);
@@ -320,6 +638,7 @@ bool Rom::patch_simple(std::string_view path, PixiConfig& cfg)
 	auto loc_warnings = asar_getwarnings(&warn_count);
 	for (int i = 0; i < warn_count; i++)
 		cfg.WarningList.push_back(loc_warnings[i].fullerrdata);
+	track_written_blocks();
 	DEBUGFMTMSG("Patching for {} successful\n", path);
 	return true;
 }
@@ -335,9 +654,18 @@ bool Rom::patch_simple_main(std::string_view path, PixiConfig& cfg) {
 							 m_main_memory_files[SpriteFile::Clusterptr],
 							 m_main_memory_files[SpriteFile::Extendedptr],
 							 m_main_memory_files[SpriteFile::Extendedcapeptr],
-							 m_main_memory_files[SpriteFile::Customsize]
+							 m_main_memory_files[SpriteFile::Customsize],
+							 m_main_memory_files[SpriteFile::Routinehashes]
 							};
-	auto params = paramsWrap.construct(path, m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
+	// the cleanup can only go ahead of the patch as a memory file, which asar reads instead of the one on disk
+	MemoryFile file{ std::string{ path }, false };
+	if (!m_cleanup.empty()) {
+		std::ifstream source{ std::string{ path } };
+		std::string content{ std::istreambuf_iterator<char>{ source }, std::istreambuf_iterator<char>{} };
+		file.insertChar(content);
+	}
+	auto params = m_cleanup.empty() ? paramsWrap.construct(path, m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size())
+		: paramsWrap.construct(with_cleanup(file), m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
 	if (!asar_patch_ex(params)) {
 		DEBUGMSG("Failure. Try fetch errors:\n");
 		int error_count;
@@ -351,6 +679,7 @@ bool Rom::patch_simple_main(std::string_view path, PixiConfig& cfg) {
 	auto loc_warnings = asar_getwarnings(&warn_count);
 	for (int i = 0; i < warn_count; i++)
 		cfg.WarningList.push_back(loc_warnings[i].fullerrdata);
+	track_written_blocks();
 	DEBUGFMTMSG("Patching for {} successful\n", path);
 	return true;
 }
@@ -369,20 +698,74 @@ SpriteMemoryFiles& Rom::main_memory_files() {
 	return m_main_memory_files;
 }
 
+Rom::Prelude& Rom::sprite_prelude(const std::string& dir, PixiConfig& cfg)
+{
+	auto [entry, added] = m_preludes.try_emplace(dir, cfg.AsmDir + "_prelude.asm");
+	Prelude& prelude = entry->second;
+	if (!added)
+		return prelude;
+	std::set<std::string> generated{ std::filesystem::path{ cfg.AsmDirPath + "/config.asm" }.lexically_normal().generic_string() };
+	auto sa1def_macros = collect_macros({ cfg.AsmDirPath + "/sa1def.asm" }, generated);
+	auto header_macros = collect_macros({ dir + "_header.asm" }, generated);
+	if (!sa1def_macros || !header_macros) {
+		if (cfg.Debug)
+			fmt::print("sa1def.asm or {}_header.asm do more than defining things, the sprites of the folder include them\n", dir);
+		return prelude;
+	}
+
+	// asar works the defines out on a copy of the rom, nothing it does there ends up in the real one
+	MemoryFile probe{ cfg.AsmDir + "_prelude_probe.asm", false };
+	probe.insertChar("incsrc \"!{SA1DEF}sa1def.asm\"\nincsrc shared.asm\nincsrc \"!{HEADER}_header.asm\"\n");
+	std::string escapedDir = escapeDefines(dir);
+	std::string escapedAsmDir = escapeDefines(cfg.AsmDir);
+	StructParams paramsWrap(m_config_patch, m_shared_patch);
+	paramsWrap.add_defines({
+		{StructParams::define_sa1def.data(),  escapedAsmDir.data() },
+		{StructParams::define_header.data(), escapedDir.data() }
+	});
+	std::vector<uint8_t> scratch(m_data.ptr_at(m_header_offset), m_data.ptr_at(m_header_offset) + m_size);
+	int scratch_size = m_size;
+	auto params = paramsWrap.construct(probe, scratch.data(), scratch.size(), scratch_size);
+	// on errors the sprites include the files themselves, and report them
+	if (!asar_patch_ex(params))
+		return prelude;
+
+	int define_count = 0;
+	auto defines = asar_getalldefines(&define_count);
+	for (int i = 0; i < define_count; i++) {
+		std::string_view name = defines[i].name;
+		// the per sprite defines are passed anyway, the assembler ones are asar's own
+		if (name == StructParams::define_sa1def || name == StructParams::define_header || name.rfind("assembler", 0) == 0)
+			continue;
+		prelude.values.emplace_back(defines[i].name, defines[i].contents);
+	}
+	for (const auto& [name, contents] : prelude.values)
+		prelude.defines.push_back({ name.c_str(), contents.c_str() });
+	constexpr std::array<std::string_view, 3> mapper_commands{ "lorom", "sa1rom", "fullsa1rom" };
+	prelude.macros.insertString("{}\n{}\n{}\n{}", mapper_commands[FromEnum(m_mapper)], *sa1def_macros,
+		std::string_view{ (const char*)m_shared_patch.Data(), m_shared_patch.Size() }, *header_macros);
+	prelude.resolved = true;
+	DEBUGFMTMSG("Prelude of {}: {} defines\n", dir, prelude.defines.size());
+	return prelude;
+}
+
 bool Rom::patch_simple_sprite(Sprite& spr, PixiConfig& cfg, std::string_view spr_name)
 {
 	std::string escapedDir = escapeDefines(spr.directory);
 	std::string escapedAsmFile = escapeDefines(spr.asm_file);
 	std::string escapedAsmDir = escapeDefines(cfg.AsmDir);
 	std::string number = std::to_string(spr.number);
-	StructParams paramsWrap(m_config_patch, m_shared_patch);
+	Prelude& prelude = sprite_prelude(spr.directory, cfg);
+	StructParams paramsWrap(m_config_patch, m_shared_patch, prelude.macros);
 	paramsWrap.add_defines({ 
 		{StructParams::define_sa1def.data(),  escapedAsmDir.data() },
 		{StructParams::define_header.data(), escapedDir.data() },
 		{StructParams::define_sprno.data(), number.data() },
 		{StructParams::define_sprite.data(), escapedAsmFile.data() }
 	});
-	auto params = paramsWrap.construct(m_sprite_patch, m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
+	if (prelude.resolved)
+		paramsWrap.add_defines(prelude.defines);
+	auto params = paramsWrap.construct(with_cleanup(prelude.resolved ? m_sprite_prelude_patch : m_sprite_patch), m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
 	if (!asar_patch_ex(params)) {
 		DEBUGMSG("Failure. Try fetch errors:\n");
 		int error_count;
@@ -396,6 +779,7 @@ bool Rom::patch_simple_sprite(Sprite& spr, PixiConfig& cfg, std::string_view spr
 	auto loc_warnings = asar_getwarnings(&warn_count);
 	for (int i = 0; i < warn_count; i++)
 		cfg.WarningList.push_back(loc_warnings[i].fullerrdata);
+	track_written_blocks();
 	DEBUGFMTMSG("Patching for {} successful\n", spr_name);
 	return true;
 }
@@ -406,73 +790,138 @@ bool Rom::patch_main(const std::string& dir, const std::string& file, PixiConfig
 	return patch_simple_main(path, cfg);
 }
 
+bool Rom::patch_main_pass(const std::vector<std::string>& hijacks, PixiConfig& cfg) {
+	MemoryFile umbrella{ cfg.AsmDir + "_main_pass.asm" };
+	umbrella.insertString("namespace nested on\n");
+	for (std::string_view file : { "main", "cluster", "extended" })
+		umbrella.insertString("namespace Pixi_{0}\nincsrc \"{1}{0}.asm\"\nnamespace off\n", file, escapeDefines(cfg.m_Paths[PathType::Asm]));
+	for (size_t i = 0; i < hijacks.size(); i++)
+		umbrella.insertString("print \"{0}{1}\"\nnamespace Pixi_hijack_{1}\nincsrc \"{2}\"\nnamespace off\n", hijack_print_marker, i, escapeDefines(hijacks[i]));
+	umbrella.insertString("namespace nested off\n");
+
+	StructParams paramsWrap{ m_main_memory_files[SpriteFile::Version],
+							 m_main_memory_files[SpriteFile::Perlevellvlptrs],
+							 m_main_memory_files[SpriteFile::Perlevelsprptrs],
+							 m_main_memory_files[SpriteFile::Perlevelt],
+							 m_main_memory_files[SpriteFile::Perlevelcustomptrtable],
+							 m_main_memory_files[SpriteFile::Defaulttables],
+							 m_main_memory_files[SpriteFile::Customstatusptr],
+							 m_main_memory_files[SpriteFile::Clusterptr],
+							 m_main_memory_files[SpriteFile::Extendedptr],
+							 m_main_memory_files[SpriteFile::Extendedcapeptr],
+							 m_main_memory_files[SpriteFile::Customsize],
+							 m_main_memory_files[SpriteFile::Routinehashes]
+							};
+	auto params = paramsWrap.construct(with_cleanup(umbrella), m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
+	// asar leaves the rom alone when the patch fails
+	if (!asar_patch_ex(params)) {
+		if (cfg.Debug) {
+			int error_count;
+			auto errors = asar_geterrors(&error_count);
+			fmt::print("The main patches and the ExtraHijacks don't assemble together, patching them one at a time:\n");
+			for (int i = 0; i < error_count; i++)
+				fmt::print("\t{}\n", errors[i].fullerrdata);
+		}
+		return false;
+	}
+	int warn_count = 0;
+	auto loc_warnings = asar_getwarnings(&warn_count);
+	for (int i = 0; i < warn_count; i++)
+		cfg.WarningList.push_back(loc_warnings[i].fullerrdata);
+	track_written_blocks();
+	DEBUGFMTMSG("Patching for {} successful\n", umbrella.Path());
+	return true;
+}
+
+// the entry points a sprite declares with print "INIT ",pc and the like, and the sprite types they're read for
+enum class EntryPoint : size_t {
+	Init,
+	Main,
+	Cape,
+	Carriable,
+	Carried,
+	Kicked,
+	Mouth,
+	Goal,
+	SIZE
+};
+static constexpr std::array<std::pair<std::string_view, int>, FromEnum(EntryPoint::SIZE)> entry_prints{ {
+	{ "INIT", -1 }, { "MAIN", -1 }, { "CAPE", 1 }, { "CARRIABLE", 0 }, { "CARRIED", 0 }, { "KICKED", 0 }, { "MOUTH", 0 }, { "GOAL", 0 }
+} };
+
+static std::string_view trim_view(std::string_view text) {
+	size_t start = text.find_first_not_of(" \t\r\n");
+	if (start == std::string_view::npos)
+		return {};
+	return text.substr(start, text.find_last_not_of(" \t\r\n") - start + 1);
+}
+
+// the hex number after the prefix of a print, spaces and a $ are skipped
+static std::optional<int> print_value(std::string_view print, size_t prefix) {
+	std::string_view number = trim_view(print.substr(prefix));
+	if (!number.empty() && number[0] == '$')
+		number.remove_prefix(1);
+	int value = 0;
+	auto [end, ec] = std::from_chars(number.data(), number.data() + number.size(), value, 16);
+	if (ec != std::errc{} || end == number.data())
+		return std::nullopt;
+	return value;
+}
+
 bool Rom::patch_sprite(Sprite& spr, const std::vector<std::string>& extraDefines, PixiConfig& cfg) {
 
 	bool retval = patch_simple_sprite(spr, cfg, spr.asm_file);
-	std::map<std::string, int> ptr_map = {
-		std::pair<std::string, int>("init", 0x018021),
-		std::pair<std::string, int>("main", 0x018021),
-		std::pair<std::string, int>("cape", 0x000000),
-		std::pair<std::string, int>("mouth", 0x000000),
-		std::pair<std::string, int>("kicked", 0x000000),
-		std::pair<std::string, int>("carriable", 0x000000),
-		std::pair<std::string, int>("carried", 0x000000),
-		std::pair<std::string, int>("goal", 0x000000)
-	};
+	if (cfg.CostReport)
+		m_sprite_blocks[spr.asm_file] = m_last_blocks;
+	std::array<int, FromEnum(EntryPoint::SIZE)> entries{ 0x018021, 0x018021 };
+	// code in banks $00-$7D is also mapped in $80-$FD, where it runs at 3.58 MHz
+	const bool fast = fastrom(cfg);
 	int print_count = 0;
 	auto asar_prints = asar_getprints(&print_count);
-	std::vector<std::string> prints{};
-	prints.reserve(print_count);
-	for (int i = 0; i < print_count; i++) {
-		prints.push_back({ asar_prints[i] });
-		trim(prints[i]);
-	}
 	if (cfg.Debug)
 		fmt::print("{}\n", spr.asm_file);
 	if (print_count > 2 && cfg.Debug)
 		fmt::print("Prints:\n");
 
-	for (const auto& print : prints) {
-		if (!print.compare(0, 4, "INIT"))
-			ptr_map["init"] = std::stol(print.substr(4), nullptr, 16);
-		else if (!print.compare(0, 4, "MAIN"))
-			ptr_map["main"] = std::stol(print.substr(4), nullptr, 16);
-		else if (!print.compare(0, 4, "CAPE") && spr.sprite_type == 1)
-			ptr_map["cape"] = std::stol(print.substr(4), nullptr, 16);
-		else if (!print.compare(0, 9, "CARRIABLE") && spr.sprite_type == 0)
-			ptr_map["carriable"] = std::stol(print.substr(9), nullptr, 16);
-		else if (!print.compare(0, 7, "CARRIED") && spr.sprite_type == 0)
-			ptr_map["carried"] = std::stol(print.substr(7), nullptr, 16);
-		else if (!print.compare(0, 6, "KICKED") && spr.sprite_type == 0)
-			ptr_map["kicked"] = std::stol(print.substr(6), nullptr, 16);
-		else if (!print.compare(0, 5, "MOUTH") && spr.sprite_type == 0)
-			ptr_map["mouth"] = std::stol(print.substr(5), nullptr, 16);
-		else if (!print.compare(0, 4, "GOAL") && spr.sprite_type == 0)
-			ptr_map["goal"] = std::stol(print.substr(4), nullptr, 16);
-		else if (!print.compare(0, 4, "VERG")) {
-			// if the user has put $ to indicate the hex number we skip it
-			auto required_version = std::stol(print.substr(print[4] == '$' ? 5 : 4), nullptr, 16);
-			if (PixiConfig::VERSION < required_version) {
+	for (int i = 0; i < print_count; i++) {
+		std::string_view print = trim_view(asar_prints[i]);
+		auto entry = std::find_if(entry_prints.begin(), entry_prints.end(), [&print, &spr](const auto& entry_print) {
+			return print.rfind(entry_print.first, 0) == 0 && (entry_print.second == -1 || entry_print.second == spr.sprite_type);
+		});
+		if (entry != entry_prints.end()) {
+			auto value = print_value(print, entry->first.size());
+			if (!value)
+				ErrorState::pixi_error("Sprite {} printed \"{}\", which isn't followed by an address\n", spr.asm_file, print);
+			entries[entry - entry_prints.begin()] = fast && (*value >> 16) < 0x7E ? *value | 0x800000 : *value;
+		}
+		else if (print.rfind("Routine: ", 0) == 0) {
+			m_used_routines.emplace(print.substr(9, print.find(' ', 9) - 9));
+			if (cfg.Debug)
+				fmt::print("\t{}\n", print);
+		}
+		else if (print.rfind("VERG", 0) == 0) {
+			auto required_version = print_value(print, 4);
+			if (required_version && PixiConfig::VERSION < *required_version) {
 				ErrorState::pixi_error("The sprite {} requires to be inserted at least with Pixi 1.{:02X}, this is Pixi 1.{:02X}\n",
-					spr.asm_file, required_version, PixiConfig::VERSION);
+					spr.asm_file, *required_version, PixiConfig::VERSION);
 			}
 		}
 		else if (cfg.Debug) {
 			fmt::print("\t{}\n", print);
 		}
 	}
-	spr.table.init = Pointer(ptr_map["init"]);
-	spr.table.main = Pointer(ptr_map["main"]);
-	if (spr.table.init.is_empty() && spr.table.main.is_empty())
+	spr.table->init = Pointer(entries[FromEnum(EntryPoint::Init)]);
+	spr.table->main = Pointer(entries[FromEnum(EntryPoint::Main)]);
+	if (spr.table->init.is_empty() && spr.table->main.is_empty())
 		ErrorState::pixi_error("Sprite {} had neither INIT nor MAIN defined in its file, insertion has been aborted.", spr.asm_file);
 	if (spr.sprite_type == 1)
-		spr.extended_cape_ptr = Pointer(ptr_map["cape"]);
+		*spr.extended_cape_ptr = Pointer(entries[FromEnum(EntryPoint::Cape)]);
 	else if (spr.sprite_type == 0) {
-		spr.ptrs.carried() = Pointer(ptr_map["carried"]);
-		spr.ptrs.carriable() = Pointer(ptr_map["carriable"]);
-		spr.ptrs.kicked() = Pointer(ptr_map["kicked"]);
-		spr.ptrs.mouth() = Pointer(ptr_map["mouth"]);
-		spr.ptrs.goal() = Pointer(ptr_map["goal"]);
+		spr.ptrs->carried() = Pointer(entries[FromEnum(EntryPoint::Carried)]);
+		spr.ptrs->carriable() = Pointer(entries[FromEnum(EntryPoint::Carriable)]);
+		spr.ptrs->kicked() = Pointer(entries[FromEnum(EntryPoint::Kicked)]);
+		spr.ptrs->mouth() = Pointer(entries[FromEnum(EntryPoint::Mouth)]);
+		spr.ptrs->goal() = Pointer(entries[FromEnum(EntryPoint::Goal)]);
 	}
 	if (cfg.Debug) {
 		if (spr.sprite_type == 0)
@@ -480,29 +929,174 @@ bool Rom::patch_sprite(Sprite& spr, const std::vector<std::string>& extraDefines
 				"\tCARRIABLE: ${:06X}\n\tCARRIED: ${:06X}\n\tKICKED: ${:06X}\n"
 				"\tMOUTH: ${:06X}\n\tGOAL: ${:06X}"
 				"\n__________________________________\n",
-				spr.table.init.addr(), spr.table.main.addr(), spr.ptrs.carriable().addr(),
-				spr.ptrs.carried().addr(), spr.ptrs.kicked().addr(), spr.ptrs.mouth().addr(), spr.ptrs.goal().addr());
+				spr.table->init.addr(), spr.table->main.addr(), spr.ptrs->carriable().addr(),
+				spr.ptrs->carried().addr(), spr.ptrs->kicked().addr(), spr.ptrs->mouth().addr(), spr.ptrs->goal().addr());
 		else if (spr.sprite_type == 1)
 			fmt::print("\tINIT: ${:06X}\n\tMAIN: ${:06X}\n\tCAPE: ${:06X}"
 				"\n__________________________________\n",
-				spr.table.init.addr(), spr.table.main.addr(), spr.extended_cape_ptr.addr());
+				spr.table->init.addr(), spr.table->main.addr(), spr.extended_cape_ptr->addr());
 		else
 			fmt::print("\tINIT: ${:06X}\n\tMAIN: ${:06X}\n"
 				"\n__________________________________\n",
-				spr.table.init.addr(), spr.table.main.addr());
+				spr.table->init.addr(), spr.table->main.addr());
 	}
 	return retval;
 }
 
-void Rom::close()
+void Rom::write_ips(const std::string& path)
 {
-	DEBUGFMTMSG("Writing to ROM, size: {:X} bytes\n", m_data.size());
-	FILE* fp = fileopen(m_name.c_str(), "wb");
-	size_t written = fwrite(m_data.start(), sizeof(uint8_t), m_data.size(), fp);
-	assert(written == m_data.size());
+	std::vector<uint8_t> out{ 'P', 'A', 'T', 'C', 'H' };
+	for (const auto& range : m_written) {
+		size_t start = range.first;
+		size_t end = std::min(range.second, m_data.size());
+		while (start < end) {
+			// a record at 0x454F46 would be read as the "EOF" marker, so it starts one byte earlier
+			if (start == 0x454F46)
+				start--;
+			if (start > 0xFFFFFF)
+				ErrorState::pixi_error("IPS patches can't address more than 16MB, use -bps instead\n");
+			size_t len = std::min<size_t>(end - start, 0xFFFF);
+			out.insert(out.end(), { (uint8_t)(start >> 16), (uint8_t)(start >> 8), (uint8_t)start, (uint8_t)(len >> 8), (uint8_t)len });
+			out.insert(out.end(), m_data.ptr_at(start), m_data.ptr_at(start + len));
+			start += len;
+		}
+	}
+	out.insert(out.end(), { 'E', 'O', 'F' });
+	FILE* fp = fileopen(path.c_str(), "wb");
+	fwrite(out.data(), sizeof(uint8_t), out.size(), fp);
 	fclose(fp);
 }
 
+// everything outside of the written ranges is copied from the original rom, so only those are stored in the patch
+void Rom::write_bps(const std::string& path)
+{
+	constexpr uint64_t SOURCE_READ = 0;
+	constexpr uint64_t TARGET_READ = 1;
+	std::vector<uint8_t> out{ 'B', 'P', 'S', '1' };
+	auto encode = [&out](uint64_t value) {
+		while (true) {
+			uint8_t low = value & 0x7F;
+			value >>= 7;
+			if (value == 0) {
+				out.push_back(0x80 | low);
+				break;
+			}
+			out.push_back(low);
+			value--;
+		}
+	};
+	auto encode_u32 = [&out](uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			out.push_back((uint8_t)(value >> (i * 8)));
+	};
+	const size_t target_size = m_data.size();
+	encode(m_source_size);
+	encode(target_size);
+	encode(0);
+	size_t pos = 0;
+	for (auto [start, end] : m_written) {
+		end = std::min(end, target_size);
+		if (start >= end)
+			continue;
+		if (start > pos)
+			encode(((uint64_t)(start - pos - 1) << 2) | SOURCE_READ);
+		encode(((uint64_t)(end - start - 1) << 2) | TARGET_READ);
+		out.insert(out.end(), m_data.ptr_at(start), m_data.ptr_at(end));
+		pos = end;
+	}
+	if (pos < target_size)
+		encode(((uint64_t)(target_size - pos - 1) << 2) | SOURCE_READ);
+	encode_u32(m_source_crc);
+	encode_u32(crc32(m_data.start(), target_size));
+	encode_u32(crc32(out.data(), out.size()));
+	FILE* fp = fileopen(path.c_str(), "wb");
+	fwrite(out.data(), sizeof(uint8_t), out.size(), fp);
+	fclose(fp);
+}
+
+void Rom::fix_checksum()
+{
+	// the checksum bytes are summed as FF FF 00 00, which adds up to the same as any valid checksum and its complement
+	const size_t checksum_offset = snes_to_pc(0x00FFDC);
+	const std::vector<uint8_t> blank{ 0xFF, 0xFF, 0x00, 0x00 };
+	write(checksum_offset, blank);
+	const uint8_t* rom = m_data.ptr_at(m_header_offset);
+	const size_t len = (size_t)m_size;
+	auto sum = [rom](size_t from, size_t to) {
+		uint32_t total = 0;
+		for (size_t i = from; i < to; i++)
+			total += rom[i];
+		return total;
+	};
+	uint32_t checksum = 0;
+	if ((len & (len - 1)) == 0) {
+		checksum = sum(0, len);
+	}
+	else {
+		// the part past the largest power of two is mirrored until it's as big as it
+		size_t first = 1;
+		while (first * 2 <= len)
+			first *= 2;
+		checksum = sum(0, first) + sum(first, len) * (uint32_t)(first / (len - first));
+	}
+	checksum &= 0xFFFF;
+	write(checksum_offset, { (uint8_t)(checksum ^ 0xFF), (uint8_t)((checksum >> 8) ^ 0xFF), (uint8_t)checksum, (uint8_t)(checksum >> 8) });
+	DEBUGFMTMSG("Checksum ${:04X}\n", checksum);
+}
+
+void Rom::close(const PixiConfig& cfg)
+{
+	// a rom that was reverted keeps the checksum it was loaded with
+	if (!m_journal.empty())
+		fix_checksum();
+	if (cfg.Debug) {
+		fmt::print("Written areas:\n");
+		for (auto [start, end] : m_written)
+			fmt::print("\t${:06X}-${:06X} (PC 0x{:X}, {} bytes)\n", pc_to_snes(start), pc_to_snes(end - 1), start, end - start);
+	}
+	if (cfg.Output == RomOutput::Rom && m_buffer) {
+		size_t size = m_header_offset + m_size;
+		if (size > m_buffer->capacity) {
+			*m_buffer->size = size;
+			ErrorState::pixi_error("The rom grew to {} bytes, more than the buffer capacity of {} bytes\n", size, m_buffer->capacity);
+		}
+		memcpy(m_buffer->data, m_data.start(), size);
+		*m_buffer->size = size;
+		return;
+	}
+	if (cfg.Output == RomOutput::Rom) {
+		DEBUGFMTMSG("Writing to ROM, size: {:X} bytes\n", m_data.size());
+		FILE* fp = fileopen(m_name.c_str(), "wb");
+		size_t written = fwrite(m_data.start(), sizeof(uint8_t), m_data.size(), fp);
+		assert(written == m_data.size());
+		fclose(fp);
+		return;
+	}
+	// anything past the end of the original rom is new
+	if (m_data.size() > m_source_size)
+		mark_written(m_source_size, m_data.size() - m_source_size);
+	size_t total = 0;
+	size_t areas = 0;
+	for (auto [start, end] : m_written) {
+		if (start >= m_data.size())
+			break;
+		total += std::min(end, m_data.size()) - start;
+		areas++;
+	}
+	std::string path = subfile_name(m_name, cfg.Output == RomOutput::Ips ? "ips" : "bps");
+	if (cfg.Output == RomOutput::Ips)
+		write_ips(path);
+	else
+		write_bps(path);
+	fmt::print("{} left untouched, {} bytes in {} areas written to {}\n", m_name, total, areas, path);
+}
+
+bool Rom::fastrom(const PixiConfig& cfg)
+{
+	// bit 4 of the map mode byte of the header
+	return cfg.FastRom && m_mapper == MapperType::LoRom && (data()[0x7FD5] & 0x10) != 0;
+}
+
 void Rom::run_checks()
 {
 	auto version = at_snes(0x02FFE2 + 4);
@@ -515,11 +1109,10 @@ void Rom::run_checks()
 		ErrorState::pixi_warning("You're inserting Pixi without having modified a level in Lunar Magic, this will cause bugs\nDo you "
 			"want to abort insertion now [y/n]?\nIf you choose 'n', to fix the bugs just reapply Pixi after having "
 			"modified a level\n");
-		char c = (char)getchar();
+		char c = ErrorState::read_answer();
 		if (tolower(c) == 'y') {
 			ErrorState::pixi_error("Insertion was stopped, press any button to exit...\n");
 		}
-		fflush(stdin);
 	}
 
 	auto vram_jump = at_snes(0x00F6E4);
@@ -1,5 +1,8 @@
 #pragma once
+#include <memory>
+#include <set>
 #include "Entities.h"
+#include "Routines.h"
 
 void addIncSrcToFile(MemoryFile& file, const std::vector<std::string>& toInclude);
 
@@ -15,6 +18,20 @@ constexpr std::string_view MapperToString(MapperType mapper) {
 	return StringMappers[FromEnum(mapper)];
 }
 
+// a range asar wrote, as it reports them after every patch
+struct WrittenBlock {
+	int snes;
+	int pc;
+	int size;
+};
+
+// where the rom of a library insertion lives, see pixi_insert_buffer
+struct RomBuffer {
+	uint8_t* data;
+	size_t* size;
+	size_t capacity;
+};
+
 class Rom {
 	using s = std::numeric_limits<size_t>;
 	inline static constexpr size_t MAX_ROM_SIZE = 16 * 1024 * 1024;
@@ -32,7 +49,31 @@ SPRITE_ENTRY_!NUMBER:
 warnings pull
 namespace nested off
 )";
+	// same, when the prelude of the sprite's folder is resolved: the defines come in as additional defines
+	inline static constexpr std::string_view sprite_prelude_asm_patch = R"(
+namespace nested on
+incsrc "!{SA1DEF}_prelude.asm"
+freecode cleaned
+warnings push
+warnings disable w1005
+SPRITE_ENTRY_!NUMBER:
+    incsrc "!SPRITE"
+warnings pull
+namespace nested off
+)";
+	// sa1def.asm, shared.asm and a folder's _header.asm worked out once, see Prelude.h
+	struct Prelude {
+		bool resolved = false;
+		// the mapper and the macros, as _prelude.asm
+		MemoryFile macros;
+		std::vector<std::pair<std::string, std::string>> values{};
+		std::vector<definedata> defines{};
+
+		Prelude(const std::string& path) : macros(path) {}
+	};
 	std::string m_name;
+	// set when the rom was given in memory, close writes it back there instead of to m_name
+	std::optional<RomBuffer> m_buffer{};
 	int m_size = 0;
 	ByteArray<uint8_t, MAX_ROM_SIZE> m_data;
 	size_t m_header_offset = 0;
@@ -41,15 +82,85 @@ namespace nested off
 	MemoryFile m_shared_patch{};
 	MemoryFile m_config_patch{};
 	MemoryFile m_sprite_patch{ Sprite::TEMP_SPR_FILE };
+	MemoryFile m_sprite_prelude_patch{ Sprite::TEMP_SPR_FILE };
+	// keyed by sprite folder, they depend on shared.asm so they're only made once the sprites are being inserted
+	std::map<std::string, Prelude> m_preludes{};
+	// pc ranges [start, end) of the (headered) rom that were written since it was loaded, merged when they touch
+	std::map<size_t, size_t> m_written{};
+	size_t m_source_size = 0;
+	uint32_t m_source_crc = 0;
+	// content of every written range as it was when the rom was loaded, keyed by pc offset
+	std::map<size_t, std::vector<uint8_t>> m_original{};
+	// every write in order with the bytes it left, rolling back replays it up to the checkpoint
+	struct JournalEntry {
+		size_t offset;
+		std::vector<uint8_t> data;
+	};
+	std::vector<JournalEntry> m_journal{};
+	// the shared routines of this insertion, the ones clean left in the rom (with their address)
+	// and the ones that the inserted sprites called
+	std::vector<SharedRoutine> m_routines{};
+	std::map<std::string, int> m_retained_routines{};
+	std::set<std::string> m_used_routines{};
+	// the autocleans of clean, done by the first assembly that runs on the rom afterwards
+	std::string m_cleanup{};
+	std::unique_ptr<MemoryFile> m_first_patch{};
+	// what the last patch wrote, and (with -cost) what the patch of every sprite file wrote, keyed by asm file
+	std::vector<WrittenBlock> m_last_blocks{};
+	std::map<std::string, std::vector<WrittenBlock>> m_sprite_blocks{};
+	// RATS tags that were in the rom when clean ran, pc offset of the tag -> size of the tag and the data it protects
+	// asar doesn't report what an autoclean frees as written, so they're looked at after every patch instead
+	std::map<size_t, size_t> m_rats_tags{};
+
+	// works out the header, the mapper and the size once the data is loaded
+	void init();
+	void mark_written(size_t offset, size_t len);
+	// keeps the loaded content of the parts of [offset, offset + len) that weren't written before
+	// asar has already overwritten them when the written blocks are known, so then they're read from the rom file (or
+	// the buffer it was given in), which stays untouched until close
+	void save_original(size_t offset, size_t len, bool from_file);
+	void journal(size_t offset, size_t len);
+	// adds what the last asar patch wrote, the cleanup is done once a patch succeeded
+	void track_written_blocks();
+	void find_rats_tags();
+	// journals the blocks the last patch freed: the ones whose tag isn't there anymore
+	void track_cleaned_blocks();
+	// the patch itself, or a copy of it that starts with the cleanup if it's still to be done
+	const MemoryFile& with_cleanup(const MemoryFile& patch);
+	// hashes of the routines in every slot when the rom was last inserted into, 0 if unknown
+	std::vector<uint64_t> inserted_routine_hashes();
+	Prelude& sprite_prelude(const std::string& dir, PixiConfig& cfg);
+	// the same checksum asar would generate for the rom as it is now
+	void fix_checksum();
+	void write_ips(const std::string& path);
+	void write_bps(const std::string& path);
 public:
+	// pointer to every shared routine (as many as -nr allows), and (in main.asm) a pointer to the hashes of the routines in those slots
+	inline static constexpr int ROUTINE_POINTERS = 0x03E05C;
+	inline static constexpr int ROUTINE_HASHES = 0x02FFF4;
+	inline static constexpr int ROUTINE_SLOTS = PixiConfig::MAX_ROUTINES;
+
 	Rom() = default;
 	Rom(std::string romname);
+	// the content comes from the buffer and close puts it back there, romname only names the files that go with the rom
+	Rom(std::string romname, RomBuffer buffer);
 	Rom& operator=(Rom&& other) noexcept;
-	constexpr MapperType mapper();
+	constexpr MapperType mapper() const { return m_mapper; }
+	bool in_memory() const { return m_buffer.has_value(); }
 	const ByteArrayView<uint8_t> data();
 
 	int& size() { return m_size; }
 
+	struct Checkpoint {
+		size_t entries = 0;
+		int size = 0;
+	};
+	Checkpoint loaded() const { return { 0, (int)(m_source_size - m_header_offset) }; }
+	// puts back the content the rom had at cp, only the ranges written after it are touched
+	void rollback(const Checkpoint& cp);
+	// remembers the checksum of the data as loaded, which a bps patch needs, has to be called before any change
+	void record_source();
+
 	// all of these functions access the data directly, without checking for the header
 	void write(size_t offset, const uint8_t* data, size_t len);
 	void write(size_t offset, const std::vector<uint8_t>& data);
@@ -69,8 +180,19 @@ public:
 	size_t pc_to_snes(size_t address, bool header = true);
 	size_t snes_to_pc(size_t address, bool header = true);
 	Pointer pointer_snes(int address, int size = 3, int bank = 0x00);
+	// a pointer of a planar table, its high and bank bytes are plane and 2 * plane bytes after the low one
+	Pointer planar_pointer_snes(int address, int plane);
+	// cleans what the previous insertion put in the rom, except the shared routines that didn't change
 	void clean(PixiConfig& cfg);
+	// has to be called after every sprite has been patched: cleans the kept routines that no sprite used anymore
+	// and prepares the table of routine hashes for main.asm
+	void finish_routines(PixiConfig& cfg);
 	SpriteMemoryFiles& main_memory_files();
+	const std::vector<SharedRoutine>& shared_routines() const { return m_routines; }
+	// the pointer to the routine in slot as the insertion left it, $FFFFFF if it's empty
+	int routine_pointer(int slot);
+	// empty unless -cost was given, or if the sprite file wasn't inserted
+	const std::vector<WrittenBlock>& sprite_blocks(const std::string& asm_file) const;
 	MemoryFile& shared_patch();
 	MemoryFile& config_patch();
 
@@ -88,13 +210,19 @@ public:
 	// calls patch_simple_main appending the dir before the filename
 	bool patch_main(const std::string& dir, const std::string& file, PixiConfig& cfg);
 
+	// main.asm, cluster.asm, extended.asm and every ExtraHijacks patch in a single assembly, each in its own namespace
+	// returns false with the rom untouched if they don't assemble together, they have to be patched one at a time then
+	// every print after one starting with hijack_print_marker (followed by the index in hijacks) comes from that patch
+	bool patch_main_pass(const std::vector<std::string>& hijacks, PixiConfig& cfg);
+	inline static constexpr std::string_view hijack_print_marker = "pixi hijack ";
+
 	// prepares the memory file contaning the wrapper around spr and then calls patch_simple_sprite
 	bool patch_sprite(Sprite& spr, const std::vector<std::string>& extraDefines, PixiConfig& cfg);
 	
 	// generic memoryfile patch
 	template <typename... Files>
 	bool patch(MemoryFile& file, PixiConfig& cfg, Files&... files) {
-		StructParams paramsWrap{ file, files... };
+		StructParams paramsWrap{ with_cleanup(file), files... };
 		auto params = paramsWrap.construct(m_data.ptr_at(m_header_offset), MAX_ROM_SIZE, size());
 		if (!asar_patch_ex(params)) {
 			DEBUGMSG("Failure. Try fetch errors:\n");
@@ -109,10 +237,15 @@ public:
 		auto loc_warnings = asar_getwarnings(&warn_count);
 		for (int i = 0; i < warn_count; i++)
 			cfg.WarningList.push_back(loc_warnings[i].fullerrdata);
+		track_written_blocks();
 		DEBUGFMTMSG("Patching for {} successful\n", paramsWrap.PatchLoc());
 		return true;
 	}
 
-	void close();
+	// fixes the checksum if anything changed and writes the rom back, or only the patch with the changes if cfg asks for one
+	// a rom in memory that doesn't fit in its buffer anymore is an error, the buffer's size is set to what it needs
+	void close(const PixiConfig& cfg);
 	void run_checks();
+	// whether cfg asks for FastROM pointers and the rom can take them: LoROM with the FastROM bit set in the header
+	bool fastrom(const PixiConfig& cfg);
 };
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "Routines.h"
+#include <map>
+#include <sstream>
+
+// the text of the file without comments
+static std::string read_source(const std::string& path) {
+	std::ifstream file{ path };
+	std::string source{};
+	std::string line{};
+	while (std::getline(file, line)) {
+		auto comment = line.find(';');
+		if (comment != std::string::npos)
+			line.erase(comment);
+		source += line;
+		source += '\n';
+	}
+	return source;
+}
+
+// routines called with %Name(), a call whose name comes from a macro argument or a define (%<name>(), %!name())
+// could be any of them, the first one is put in dynamic
+static std::vector<std::string> find_calls(const std::string& source, const std::map<std::string, size_t>& index, std::string* dynamic = nullptr) {
+	std::vector<std::string> calls{};
+	for (size_t pos = source.find('%'); pos != std::string::npos; pos = source.find('%', pos + 1)) {
+		size_t end = pos + 1;
+		bool substituted = false;
+		while (end < source.size() && (std::isalnum((unsigned char)source[end]) || source[end] == '_' ||
+			source[end] == '<' || source[end] == '>' || source[end] == '!')) {
+			substituted |= source[end] == '<' || source[end] == '!';
+			end++;
+		}
+		if (end >= source.size() || source[end] != '(' || end == pos + 1)
+			continue;
+		std::string name = source.substr(pos + 1, end - pos - 1);
+		if (substituted) {
+			if (dynamic != nullptr && dynamic->empty())
+				*dynamic = fmt::format("%{}()", name);
+			continue;
+		}
+		if (index.count(name) && std::find(calls.begin(), calls.end(), name) == calls.end())
+			calls.push_back(name);
+	}
+	return calls;
+}
+
+struct Include {
+	std::string path{};
+	// incbin, the file is data and doesn't include anything itself
+	bool binary = false;
+	// false when the path is built from defines or macro arguments, path is then the text as written
+	bool resolved = true;
+};
+
+// files included with incsrc or incbin, relative to the folder of the file that includes them
+static std::vector<Include> find_includes(const std::string& source, const std::filesystem::path& dir) {
+	std::vector<Include> includes{};
+	std::istringstream lines{ source };
+	std::string line{};
+	while (std::getline(lines, line)) {
+		std::string lower = line;
+		strtolower(lower);
+		for (size_t pos = lower.find("inc"); pos != std::string::npos; pos = lower.find("inc", pos + 3)) {
+			if (pos > 0 && (std::isalnum((unsigned char)lower[pos - 1]) || lower[pos - 1] == '_'))
+				continue;
+			bool binary = lower.compare(pos, 6, "incbin") == 0;
+			if (!binary && lower.compare(pos, 6, "incsrc") != 0)
+				continue;
+			std::string path = line.substr(pos + 6);
+			auto colon = path.find(" : ");
+			if (colon != std::string::npos)
+				path.erase(colon);
+			// incbin file.bin -> $128000 puts the data somewhere else
+			auto target = path.find("->");
+			if (binary && target != std::string::npos)
+				path.erase(target);
+			trim(path);
+			if (path.size() >= 2 && path.front() == '"') {
+				auto quote = path.find('"', 1);
+				path = path.substr(1, quote == std::string::npos ? std::string::npos : quote - 1);
+			}
+			else if (binary) {
+				// incbin file.bin:0-7F only includes a range of the file
+				auto range = path.find(':');
+				if (range != std::string::npos && range + 1 < path.size() && path[range + 1] != '/' && path[range + 1] != '\\')
+					path.erase(range);
+			}
+			if (path.empty())
+				continue;
+			if (path.find_first_of("!<") != std::string::npos)
+				includes.push_back({ path, binary, false });
+			else
+				includes.push_back({ (dir / path).lexically_normal().string(), binary });
+		}
+	}
+	return includes;
+}
+
+// folds the content of every file source includes, directly or not, into hash, each file once
+static uint64_t hash_includes(const std::string& source, const std::filesystem::path& dir, uint64_t hash, std::set<std::string>& visited) {
+	for (const Include& include : find_includes(source, dir)) {
+		if (!include.resolved || !visited.insert(include.path).second)
+			continue;
+		if (include.binary) {
+			uint64_t content = file_hash(include.path).value_or(0);
+			hash = fnv1a_hash(&content, sizeof(content), hash);
+			continue;
+		}
+		std::string included = read_source(include.path);
+		hash = fnv1a_hash(included.data(), included.size(), hash);
+		hash = hash_includes(included, std::filesystem::path(include.path).parent_path(), hash, visited);
+	}
+	return hash;
+}
+
+std::vector<SharedRoutine> list_shared_routines(const PixiConfig& cfg, uint64_t context) {
+	std::vector<SharedRoutine> routines{};
+	std::map<std::string, size_t> index{};
+	for (const std::string& file : cfg.list_routines()) {
+		SharedRoutine& routine = routines.emplace_back();
+		routine.name = file.substr(0, file.length() - 4);
+		routine.path = cfg.m_Paths[PathType::Routines] + file;
+		routine.slot = (int)index.size();
+		index.emplace(routine.name, routines.size() - 1);
+	}
+	std::vector<uint64_t> own(routines.size());
+	for (size_t i = 0; i < routines.size(); i++) {
+		std::string source = read_source(routines[i].path);
+		routines[i].calls = find_calls(source, index);
+		own[i] = fnv1a_hash(routines[i].name.data(), routines[i].name.size(), context);
+		own[i] = fnv1a_hash(source.data(), source.size(), own[i]);
+		std::set<std::string> visited{};
+		own[i] = hash_includes(source, std::filesystem::path(routines[i].path).parent_path(), own[i], visited);
+	}
+	// a routine has to be inserted again when anything it calls moves, so their hashes go in as well
+	std::vector<int> state(routines.size(), 0);
+	auto hash_of = [&](auto& self, size_t i) -> uint64_t {
+		if (state[i] == 2)
+			return routines[i].hash;
+		// recursive calls only add the name, the routine is already being hashed
+		if (state[i] == 1)
+			return fnv1a_hash(routines[i].name.data(), routines[i].name.size());
+		state[i] = 1;
+		uint64_t hash = own[i];
+		for (const std::string& call : routines[i].calls) {
+			uint64_t called = self(self, index[call]);
+			hash = fnv1a_hash(&called, sizeof(called), hash);
+		}
+		routines[i].hash = hash;
+		state[i] = 2;
+		return hash;
+	};
+	for (size_t i = 0; i < routines.size(); i++)
+		hash_of(hash_of, i);
+	return routines;
+}
+
+std::set<std::string> included_files(const std::string& path) {
+	std::set<std::string> files{};
+	std::vector<std::string> pending{ path };
+	while (!pending.empty()) {
+		std::string file = std::move(pending.back());
+		pending.pop_back();
+		if (!files.insert(file).second)
+			continue;
+		for (Include& include : find_includes(read_source(file), std::filesystem::path(file).parent_path())) {
+			if (!include.resolved)
+				continue;
+			if (include.binary)
+				files.insert(std::move(include.path));
+			else
+				pending.push_back(std::move(include.path));
+		}
+	}
+	return files;
+}
+
+std::set<std::string> find_used_routines(const std::vector<std::string>& sources, const std::vector<SharedRoutine>& routines) {
+	std::map<std::string, size_t> index{};
+	for (size_t i = 0; i < routines.size(); i++)
+		index.emplace(routines[i].name, i);
+	// a call or an include the scan can't follow could reach any routine, then they all get their macro
+	auto every_routine = [&routines](const std::string& reason) {
+		ErrorState::pixi_warning("{}, so every shared routine is registered\n", reason);
+		std::set<std::string> all{};
+		for (const SharedRoutine& routine : routines)
+			all.insert(routine.name);
+		return all;
+	};
+	std::set<std::string> used{};
+	std::set<std::string> visited{};
+	// the sprites' own files can be missing (a folder without _header.asm), what they include can't
+	std::vector<std::pair<std::string, bool>> pending{};
+	for (auto it = sources.rbegin(); it != sources.rend(); ++it)
+		pending.emplace_back(*it, false);
+	while (!pending.empty()) {
+		auto [file, included] = std::move(pending.back());
+		pending.pop_back();
+		std::filesystem::path path = std::filesystem::absolute(file).lexically_normal();
+		if (!visited.insert(path.string()).second)
+			continue;
+		if (!std::filesystem::is_regular_file(path)) {
+			if (included)
+				return every_routine(fmt::format("\"{}\" is included but wasn't found next to the file that includes it", path.string()));
+			continue;
+		}
+		std::string source = read_source(path.string());
+		std::string dynamic{};
+		for (std::string& call : find_calls(source, index, &dynamic)) {
+			// the routine's own code can include files and call routines as well
+			if (used.insert(call).second)
+				pending.emplace_back(routines[index[call]].path, true);
+		}
+		if (!dynamic.empty())
+			return every_routine(fmt::format("\"{}\" calls {}, which can be any routine", path.string(), dynamic));
+		for (Include& include : find_includes(source, path.parent_path())) {
+			if (!include.resolved && !include.binary)
+				return every_routine(fmt::format("\"{}\" includes \"{}\", which depends on defines or macro arguments", path.string(), include.path));
+			if (!include.binary)
+				pending.emplace_back(std::move(include.path), true);
+		}
+	}
+	add_called_routines(routines, used);
+	return used;
+}
+
+void add_called_routines(const std::vector<SharedRoutine>& routines, std::set<std::string>& names) {
+	std::vector<std::string> pending(names.begin(), names.end());
+	while (!pending.empty()) {
+		std::string name = std::move(pending.back());
+		pending.pop_back();
+		auto routine = std::find_if(routines.begin(), routines.end(), [&name](const SharedRoutine& r) { return r.name == name; });
+		if (routine == routines.end())
+			continue;
+		for (const std::string& call : routine->calls) {
+			if (names.insert(call).second)
+				pending.push_back(call);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <set>
+#include "Config.h"
+
+// a shared routine from the routines folder, the slot is its index in the pointer table at $03E05C
+struct SharedRoutine {
+	std::string name{};
+	std::string path{};
+	int slot = 0;
+	// routines this one calls with %Name(), their code is included in it when it's inserted
+	std::vector<std::string> calls{};
+	// hash of the source, of the files it includes, of everything it calls and of the context it's assembled in
+	// code that's already in the rom with the same hash doesn't need to be inserted again
+	uint64_t hash = 0;
+};
+
+// every routine in the order create_shared_patch registers them, context is mixed in every hash
+std::vector<SharedRoutine> list_shared_routines(const PixiConfig& cfg, uint64_t context);
+
+// path and every file it includes, directly or not, as far as they can be resolved (see find_includes)
+std::set<std::string> included_files(const std::string& path);
+
+// routines called with %Name() by the source files or anything they incsrc, and the routines those call
+// when a call or an incsrc depends on defines or macro arguments, or an included file isn't found, the scan can't tell what's
+// called: it warns and returns every routine
+std::set<std::string> find_used_routines(const std::vector<std::string>& sources, const std::vector<SharedRoutine>& routines);
+
+// names adds every routine that the ones in it call, directly or not
+void add_called_routines(const std::vector<SharedRoutine>& routines, std::set<std::string>& names);
\ No newline at end of file
@@ -0,0 +1,435 @@
+#include "Pixi.h"
+#include <list>
+
+#ifndef WIN32
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static void put_u32(std::string& out, uint32_t value) {
+	for (int i = 0; i < 4; i++)
+		out.push_back((char)((value >> (i * 8)) & 0xFF));
+}
+
+static bool get_u32(const std::string& in, size_t& pos, uint32_t& value) {
+	if (pos + 4 > in.size())
+		return false;
+	value = 0;
+	for (int i = 0; i < 4; i++)
+		value |= (uint32_t)(uint8_t)in[pos + i] << (i * 8);
+	pos += 4;
+	return true;
+}
+
+static bool get_string(const std::string& in, size_t& pos, std::string& value) {
+	uint32_t len = 0;
+	if (!get_u32(in, pos, len) || pos + len > in.size())
+		return false;
+	value = in.substr(pos, len);
+	pos += len;
+	return true;
+}
+
+std::string ServerRequest::serialize() const {
+	std::string out{};
+	put_u32(out, (uint32_t)cwd.size());
+	out += cwd;
+	put_u32(out, (uint32_t)args.size());
+	for (const std::string& arg : args) {
+		put_u32(out, (uint32_t)arg.size());
+		out += arg;
+	}
+	return out;
+}
+
+bool ServerRequest::deserialize(const std::string& data) {
+	size_t pos = 0;
+	uint32_t count = 0;
+	if (!get_string(data, pos, cwd) || !get_u32(data, pos, count))
+		return false;
+	args.clear();
+	for (uint32_t i = 0; i < count; i++) {
+		std::string arg{};
+		if (!get_string(data, pos, arg))
+			return false;
+		args.push_back(std::move(arg));
+	}
+	return pos == data.size();
+}
+
+// a file that doesn't exist has the oldest possible time, so it's outdated as soon as it's created
+static std::filesystem::file_time_type modification_time(const std::string& path) {
+	std::error_code ec{};
+	auto time = std::filesystem::last_write_time(path, ec);
+	return ec ? std::filesystem::file_time_type::min() : time;
+}
+
+ResidentRom::ResidentRom() = default;
+ResidentRom::~ResidentRom() = default;
+
+void ResidentRom::remember(std::map<std::string, std::filesystem::file_time_type>& files, const std::string& path) {
+	files[path] = modification_time(path);
+}
+
+void ResidentRom::load(const std::vector<std::string>& args, const std::string& pixi_exe) {
+	std::vector<char*> argv{};
+	argv.push_back(const_cast<char*>(pixi_exe.c_str()));
+	for (const std::string& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	remember(m_parsed_from, "pixi_conf.toml");
+	cfg = PixiConfig{ (int)argv.size(), argv.data() };
+	if (cfg.Help)
+		return;
+	cfg.correct_paths();
+	remember(m_parsed_from, cfg.m_Paths[PathType::List]);
+	// adding or removing a file changes the time of the folder
+	remember(m_parsed_from, cfg.AsmDirPath + "/ExtraDefines");
+	extraDefines = cfg.list_extra_asm("/ExtraDefines");
+	sprdata = std::make_unique<SpritesData>(cfg);
+	sprdata->populate(cfg);
+	for (const Sprite& spr : (*sprdata)[ListType::Sprite].sprites) {
+		if (!spr.cfg_file.empty())
+			remember(m_descriptors, spr.cfg_file);
+	}
+	refresh_rom();
+}
+
+bool ResidentRom::outdated() const {
+	return list_outdated() || !changed_descriptors().empty();
+}
+
+bool ResidentRom::list_outdated() const {
+	for (const auto& [path, time] : m_parsed_from) {
+		if (modification_time(path) != time)
+			return true;
+	}
+	return false;
+}
+
+std::vector<std::string> ResidentRom::changed_descriptors() const {
+	std::vector<std::string> changed{};
+	for (const auto& [path, time] : m_descriptors) {
+		if (modification_time(path) != time)
+			changed.push_back(path);
+	}
+	return changed;
+}
+
+void ResidentRom::reparse(const std::string& cfg_file) {
+	remember(m_descriptors, cfg_file);
+	sprdata->reparse(cfg_file, cfg);
+}
+
+void ResidentRom::refresh_rom() {
+	// looked at before reading, a change while it's read shows up the next time
+	std::error_code ec{};
+	auto time = modification_time(cfg.RomName);
+	uintmax_t size = std::filesystem::file_size(cfg.RomName, ec);
+	if (rom != nullptr && time == m_rom_time && size == m_rom_size)
+		return;
+	rom.reset();
+	rom = std::make_unique<Rom>(cfg.RomName);
+	m_rom_time = time;
+	m_rom_size = size;
+}
+
+int ResidentRom::insert(int close_fd) {
+	return run_forked([this]() {
+		// the last configuration that was parsed set it, which isn't necessarily this one
+		MemoryFile::GlobalKeepFlag = cfg.KeepFiles;
+		return run_pixi_loaded(cfg, *rom, *sprdata, extraDefines);
+	}, close_fd);
+}
+
+#ifdef WIN32
+
+int pixi_serve(int, char*[]) {
+	ErrorState::pixi_error("--serve is not supported on Windows\n");
+	return 1;
+}
+
+int pixi_client(int, char*[]) {
+	ErrorState::pixi_error("--client is not supported on Windows\n");
+	return 1;
+}
+
+int run_forked(const std::function<int()>&, int) {
+	ErrorState::pixi_error("Running pixi in a separate process is not supported on Windows\n");
+	return 1;
+}
+
+#else
+
+// a request is only a folder and a command line, anything bigger than this isn't one
+static constexpr uint32_t MAX_REQUEST_SIZE = 1 << 20;
+// how many roms keep their parsed list and loaded data between requests, the least recently used one goes first
+static constexpr size_t MAX_RESIDENT_ROMS = 4;
+
+static volatile sig_atomic_t stop_serving = 0;
+
+static void on_stop_signal(int) {
+	stop_serving = 1;
+}
+
+static bool write_all_fd(int fd, const void* data, size_t size) {
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0) {
+		ssize_t written = write(fd, bytes, size);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		bytes += written;
+		size -= (size_t)written;
+	}
+	return true;
+}
+
+static bool read_exact_fd(int fd, void* data, size_t size) {
+	char* bytes = static_cast<char*>(data);
+	while (size > 0) {
+		ssize_t got = read(fd, bytes, size);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return false;
+		bytes += got;
+		size -= (size_t)got;
+	}
+	return true;
+}
+
+// the socket path can be given with --socket <path> anywhere in the arguments, it gets removed from them
+static std::string take_socket_path(std::vector<std::string>& args) {
+	std::string path = ServerRequest::DEFAULT_SOCKET;
+	auto res = std::find(args.begin(), args.end(), "--socket");
+	if (res != args.end()) {
+		if (res + 1 == args.end())
+			ErrorState::pixi_error("Requiring next parameter for --socket failed\n");
+		path = *(res + 1);
+		args.erase(res, res + 2);
+	}
+	return std::filesystem::absolute(path).string();
+}
+
+static sockaddr_un make_address(const std::string& path) {
+	sockaddr_un addr{};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+		ErrorState::pixi_error("Socket path \"{}\" is too long\n", path);
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+	return addr;
+}
+
+int run_forked(const std::function<int()>& insertion, int close_fd) {
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if (pid < 0)
+		return 1;
+	if (pid == 0) {
+		if (close_fd >= 0)
+			close(close_fd);
+		int devnull = open("/dev/null", O_RDONLY);
+		if (devnull >= 0) {
+			dup2(devnull, STDIN_FILENO);
+			close(devnull);
+		}
+		int retval = 1;
+		try {
+			retval = insertion();
+		}
+		catch (const PixiException&) {
+			ErrorState::asar_close_wrap();
+		}
+		fflush(stdout);
+		exit(retval);
+	}
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+using ResidentRoms = std::list<std::pair<std::string, std::unique_ptr<ResidentRom>>>;
+
+// the parse and the rom are reused when the same folder sends the same command line again and nothing changed since
+static int serve_request(const ServerRequest& req, const std::string& pixi_exe, ResidentRoms& resident, int listener) {
+	std::string key = req.serialize();
+	auto it = std::find_if(resident.begin(), resident.end(), [&key](const auto& entry) { return entry.first == key; });
+	try {
+		if (chdir(req.cwd.c_str()) != 0)
+			ErrorState::pixi_error("Couldn't change directory to \"{}\"\n", req.cwd);
+		if (it != resident.end() && it->second->outdated()) {
+			resident.erase(it);
+			it = resident.end();
+		}
+		if (it == resident.end()) {
+			auto parsed = std::make_unique<ResidentRom>();
+			parsed->load(req.args, pixi_exe);
+			if (parsed->cfg.Help)
+				return 0;
+			resident.emplace_front(key, std::move(parsed));
+			if (resident.size() > MAX_RESIDENT_ROMS)
+				resident.pop_back();
+		}
+		else {
+			resident.splice(resident.begin(), resident, it);
+		}
+		ResidentRom& rom = *resident.front().second;
+		rom.refresh_rom();
+		return rom.insert(listener);
+	}
+	catch (const PixiException&) {
+		// the error was already reported, whatever failed to parse or load is parsed again next time
+		if (it != resident.end())
+			resident.erase(it);
+		return 1;
+	}
+}
+
+// the output is terminated by a 0 byte and the 4 bytes exit code
+static void finish_response(int conn, int retval) {
+	char trailer[5] = { 0, (char)(retval & 0xFF), (char)((retval >> 8) & 0xFF), (char)((retval >> 16) & 0xFF), (char)((retval >> 24) & 0xFF) };
+	write_all_fd(conn, trailer, sizeof(trailer));
+}
+
+int pixi_serve(int argc, char* argv[]) {
+	std::vector<std::string> args(argv + 2, argv + argc);
+	std::string socket_path = take_socket_path(args);
+	if (!args.empty())
+		ErrorState::pixi_error("Invalid option for --serve \"{}\"\n", args.front());
+	std::string pixi_exe = std::filesystem::absolute(argv[0]).string();
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		ErrorState::pixi_error("Couldn't create socket: {}\n", strerror(errno));
+	sockaddr_un addr = make_address(socket_path);
+	// a socket left behind by a previous server that didn't shut down cleanly
+	unlink(socket_path.c_str());
+	if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0)
+		ErrorState::pixi_error("Couldn't listen on \"{}\": {}\n", socket_path, strerror(errno));
+
+	struct sigaction sa {};
+	sa.sa_handler = on_stop_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	fmt::print("Pixi server listening on \"{}\", press Ctrl+C to stop\n", socket_path);
+	fflush(stdout);
+	ResidentRoms resident{};
+	while (!stop_serving) {
+		int conn = accept(listener, nullptr, nullptr);
+		if (conn < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		uint32_t size = 0;
+		std::string data{};
+		ServerRequest req{};
+		if (read_exact_fd(conn, &size, sizeof(size))) {
+			if (size > MAX_REQUEST_SIZE) {
+				std::string message = fmt::format("Request of {} bytes refused, the limit is {} bytes\n", size, MAX_REQUEST_SIZE);
+				write_all_fd(conn, message.data(), message.size());
+				finish_response(conn, 1);
+				close(conn);
+				continue;
+			}
+			data.resize(size);
+			if (!read_exact_fd(conn, data.data(), size) || !req.deserialize(data)) {
+				close(conn);
+				continue;
+			}
+		}
+		else {
+			close(conn);
+			continue;
+		}
+		// everything the parse and the insertion print goes to the client
+		fflush(stdout);
+		fflush(stderr);
+		int saved_out = dup(STDOUT_FILENO);
+		int saved_err = dup(STDERR_FILENO);
+		dup2(conn, STDOUT_FILENO);
+		dup2(conn, STDERR_FILENO);
+		int retval = serve_request(req, pixi_exe, resident, listener);
+		fflush(stdout);
+		fflush(stderr);
+		dup2(saved_out, STDOUT_FILENO);
+		dup2(saved_err, STDERR_FILENO);
+		close(saved_out);
+		close(saved_err);
+		finish_response(conn, retval);
+		close(conn);
+		fmt::print("Request from \"{}\" finished with exit code {}\n", req.cwd, retval);
+		fflush(stdout);
+		// the insertion wrote the rom, it's loaded again now instead of when the next request comes
+		if (retval == 0 && !resident.empty()) {
+			try {
+				resident.front().second->refresh_rom();
+			}
+			catch (const PixiException&) {
+				resident.pop_front();
+			}
+		}
+	}
+	close(listener);
+	unlink(socket_path.c_str());
+	fmt::print("Pixi server stopped\n");
+	return 0;
+}
+
+int pixi_client(int argc, char* argv[]) {
+	ServerRequest req{};
+	req.args.assign(argv + 2, argv + argc);
+	std::string socket_path = take_socket_path(req.args);
+	if (req.args.empty())
+		ErrorState::pixi_error("Usage: pixi --client [--socket <path>] <options> <ROM>\n");
+	req.cwd = std::filesystem::current_path().string();
+
+	int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (conn < 0)
+		ErrorState::pixi_error("Couldn't create socket: {}\n", strerror(errno));
+	sockaddr_un addr = make_address(socket_path);
+	if (connect(conn, (sockaddr*)&addr, sizeof(addr)) < 0)
+		ErrorState::pixi_error("Couldn't connect to \"{}\": {}, is \"pixi --serve\" running?\n", socket_path, strerror(errno));
+
+	std::string data = req.serialize();
+	uint32_t size = (uint32_t)data.size();
+	if (!write_all_fd(conn, &size, sizeof(size)) || !write_all_fd(conn, data.data(), data.size()))
+		ErrorState::pixi_error("Couldn't send the request to the server\n");
+
+	// the last 5 bytes are the trailer with the exit code, everything before that is output
+	std::string pending{};
+	char buf[0x1000];
+	ssize_t got = 0;
+	while ((got = read(conn, buf, sizeof(buf))) != 0) {
+		if (got < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		pending.append(buf, (size_t)got);
+		if (pending.size() > 5) {
+			fwrite(pending.data(), 1, pending.size() - 5, stdout);
+			pending.erase(0, pending.size() - 5);
+		}
+	}
+	close(conn);
+	fflush(stdout);
+	if (pending.size() != 5 || pending[0] != '\0')
+		ErrorState::pixi_error("Connection to the server was lost\n");
+	int retval = 0;
+	for (int i = 0; i < 4; i++)
+		retval |= (int)(uint8_t)pending[i + 1] << (i * 8);
+	return retval;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Config.h"
+
+class Rom;
+class SpritesData;
+
+// resident mode: `pixi --serve` keeps asar loaded and waits for insertion requests on a local socket,
+// `pixi --client <options> <ROM>` forwards its command line to it and prints the output of the insertion.
+// only available on POSIX systems, the requests are served one at a time.
+// the parsed list and the loaded rom of the last few requests stay in the server, see ResidentRom.
+struct ServerRequest {
+	static constexpr const char* DEFAULT_SOCKET = "pixi.sock";
+
+	std::string cwd{};
+	std::vector<std::string> args{};
+
+	std::string serialize() const;
+	bool deserialize(const std::string& data);
+};
+
+// what --serve and --watch keep between the insertions into the same rom: the configuration, the parsed list and
+// descriptors and the loaded rom. every insertion runs on a copy of them in a forked child, so they stay as they were parsed
+class ResidentRom {
+	// the files the whole parse depends on and the descriptors, with their modification time when they were parsed
+	std::map<std::string, std::filesystem::file_time_type> m_parsed_from{};
+	std::map<std::string, std::filesystem::file_time_type> m_descriptors{};
+	std::filesystem::file_time_type m_rom_time{};
+	uintmax_t m_rom_size = 0;
+
+	static void remember(std::map<std::string, std::filesystem::file_time_type>& files, const std::string& path);
+public:
+	PixiConfig cfg{};
+	std::unique_ptr<SpritesData> sprdata{};
+	std::vector<std::string> extraDefines{};
+	std::unique_ptr<Rom> rom{};
+
+	ResidentRom();
+	~ResidentRom();
+	// parses the options (and pixi_conf.toml), the list and every descriptor, then loads the rom
+	// paths are relative to the current folder, nothing else is done when the options ask for the help
+	void load(const std::vector<std::string>& args, const std::string& pixi_exe);
+	// whether pixi_conf.toml, the list, a descriptor or the files in ExtraDefines changed since load
+	bool outdated() const;
+	// same, without the descriptors: what can only be taken into account by loading everything again
+	bool list_outdated() const;
+	// the listed descriptors that changed since they were parsed
+	std::vector<std::string> changed_descriptors() const;
+	// parses a descriptor again, see SpritesData::reparse
+	void reparse(const std::string& cfg_file);
+	// loads the rom again if the file changed since it was last loaded
+	void refresh_rom();
+	// runs an insertion on a copy of everything in a forked child, see run_forked
+	int insert(int close_fd = -1);
+};
+
+int pixi_serve(int argc, char* argv[]);
+int pixi_client(int argc, char* argv[]);
+// runs insertion in a forked child so a failing or crashing insertion doesn't take the parent with it
+// close_fd is a descriptor the child must not keep open, returns the exit code of the child
+int run_forked(const std::function<int()>& insertion, int close_fd = -1);
\ No newline at end of file
@@ -1,73 +1,81 @@
 #include "SpritesData.h"
 
-Sprite& from_table(std::vector<Sprite>& table, int level, int number, bool perlevel, ListType type) {
-	static Sprite dummy{ Sprite::INVALID };
-	if (type != ListType::Sprite) {
-		if (number > Sprite::SPRITE_COUNT)
-			return dummy;
-		return table[number];
-	}
-	if (!perlevel)
-		return table[number];
-
-	if (level > 0x200 || number > 0xFF)
-		return dummy;
-	if (level == 0x200)
-		return table[0x2000 + number];
-	else if (number > 0xB0 && number < 0xC0)
-		return table[(level * 0x10) + (number - 0xB0)];
-	return dummy;
+size_t Map16Pool::append(const Map16& block) {
+	m_blocks.push_back(block);
+	m_index[block.key()].push_back(m_blocks.size() - 1);
+	return m_blocks.size() - 1;
 }
 
-void SpritesData::patch_sprites(const std::vector<std::string>& extraDefines, Svect& sprites, size_t size, PixiConfig& cfg)
-{
-	for (size_t i = 0; i < size; i++) {
-		Sprite& spr = sprites[i];
-		if (spr.asm_file.empty())
+size_t Map16Pool::intern(const Map16& block) {
+	auto res = m_index.find(block.key());
+	if (res != m_index.end())
+		return res->second.front();
+	return append(block);
+}
+
+std::optional<size_t> Map16Pool::find_run(const std::vector<Map16>& run) const {
+	if (run.empty())
+		return std::nullopt;
+	auto res = m_index.find(run.front().key());
+	if (res == m_index.end())
+		return std::nullopt;
+	for (size_t start : res->second) {
+		if (start + run.size() > m_blocks.size())
 			continue;
-		auto res = std::find_if(sprites.rbegin() + (size - i), sprites.rend(), [spr](const Sprite& curr) {
-			if (curr.asm_file.empty())
-				return false;
-			return spr.asm_file == curr.asm_file;
-			});
-		if (res != sprites.rend()) {
-			spr.table.init = (*res).table.init;
-			spr.table.main = (*res).table.main;
-			spr.extended_cape_ptr = (*res).extended_cape_ptr;
-			spr.ptrs = (*res).ptrs;
-		}
-		else {
-			rom().patch_sprite(spr, extraDefines, cfg);
-		}
+		bool match = true;
+		for (size_t i = 1; i < run.size() && match; i++)
+			match = m_blocks[start + i].key() == run[i].key();
+		if (match)
+			return start;
+	}
+	return std::nullopt;
+}
 
-		if (spr.level < 0x200 && spr.number >= 0xB0 && spr.number < 0xC0) {
-			int pls_lv_addr = pls_data.level_ptrs[spr.level * 2] + (pls_data.level_ptrs[spr.level * 2 + 1] << 8);
-			if (pls_lv_addr == 0x0000) {
-				pls_lv_addr = pls_data.sprite_ptrs_addr + 1;
-				pls_data.level_ptrs[spr.level * 2] = (uint8_t)pls_lv_addr;
-				pls_data.level_ptrs[spr.level * 2 + 1] = (uint8_t)(pls_lv_addr >> 8);
-				pls_data.sprite_ptrs_addr += 0x20;
-			}
-			pls_lv_addr--;
-			pls_lv_addr += (spr.number - 0xB0) * 2;
+int SpritesData::slot_of(int number, ListType type) const {
+	int count = type == ListType::Sprite ? 0x100 : Sprite::SPRITE_COUNT;
+	if (number < 0 || number >= count)
+		return INVALID_SLOT;
+	return number;
+}
 
-			if (pls_data.data_addr >= 0x8000)
-				ErrorState::pixi_error("Too many Per-Level sprites. Please remove some.\n");
+void SpritesData::patch_sprite_shared(Sprite& spr, InsertedSprites& inserted, const std::vector<std::string>& extraDefines, PixiConfig& cfg)
+{
+	if (spr.asm_file.empty())
+		return;
+	auto res = inserted.find(spr.asm_file);
+	if (res != inserted.end()) {
+		const Sprite& first = *res->second;
+		spr.table->init = first.table->init;
+		spr.table->main = first.table->main;
+		*spr.extended_cape_ptr = *first.extended_cape_ptr;
+		*spr.ptrs = *first.ptrs;
+	}
+	else {
+		rom().patch_sprite(spr, extraDefines, cfg);
+		inserted.emplace(spr.asm_file, &spr);
+	}
+}
 
-			pls_data.sprite_ptrs[pls_lv_addr] = (uint8_t)(pls_data.data_addr + 1);
-			pls_data.sprite_ptrs[pls_lv_addr + 1] = (uint8_t)((pls_data.data_addr + 1) >> 8);
+void SpritesData::patch_sprites(const std::vector<std::string>& extraDefines, SpriteList& sprites, PixiConfig& cfg)
+{
+	// asm file -> first sprite that got inserted with it, every other sprite using the same file shares its pointers
+	InsertedSprites inserted{};
+	if (&sprites == &m_normal_sprites) {
+		for (size_t entry : m_perlevel_sprites.sorted_entries())
+			patch_sprite_shared(sprites.sprites[m_perlevel_sprites.owner(entry)], inserted, extraDefines, cfg);
+	}
+	for (size_t slot = 0; slot < sprites.store.size(); slot++) {
+		if (sprites.store.owner(slot) == SpriteTableStore::EMPTY)
+			continue;
+		patch_sprite_shared(sprites.at_slot(slot), inserted, extraDefines, cfg);
+	}
+}
 
-			memcpy(pls_data.data.start() + pls_data.data_addr, &spr.table, 0x10);
-			memcpy(pls_data.pls_pointers.start() + pls_data.data_addr, &spr.ptrs, 15);
-			int index = pls_data.data_addr + 0x0F;
-			if (index < 0x8000) {
-				pls_data.pls_pointers[index] = 0xFF;
-			}
-			else {
-				ErrorState::pixi_error("Per-level sprites data address out of bounds of array, value is {}", pls_data.data_addr);
-			}
-			pls_data.data_addr += 0x10;
-		}
+// sprites without custom code keep running the original ones
+static void set_default_pointers(Sprite& spr) {
+	if (!spr.table->type) {
+		spr.table->init = Pointer(Sprite::INIT_PTR + 2 * spr.number);
+		spr.table->main = Pointer(Sprite::MAIN_PTR + 2 * spr.number);
 	}
 }
 
@@ -129,23 +137,32 @@ void SpritesData::populate(PixiConfig& cfg)
 			ErrorState::pixi_error("Error on line {}: missing extension on filename {}\n", lineno, cfgname);
 		dot++;
 
-		Sprite& spr = from_table(sprites, level, sprite_id, cfg.PerLevel, type);
-		if (spr.invalid) {
-			if (type == ListType::Sprite) {
-				if (sprite_id >= 0x100)
+		Sprite* sprp = nullptr;
+		if (type == ListType::Sprite && level != 0x200) {
+			if (sprite_id >= 0x100)
+				ErrorState::pixi_error("Error on line {}: Sprite number must be less than 0x100\n", lineno);
+			if (level > 0x200)
+				ErrorState::pixi_error("Error on line {}: Level must range from 000-1FF\n", lineno);
+			if (sprite_id < 0xB0 || sprite_id >= 0xC0)
+				ErrorState::pixi_error("Error on line {}: Only sprite B0-BF must be assigned a level.\n", lineno);
+			if (m_perlevel_sprites.find(level, sprite_id) != PerLevelSprites::NOT_FOUND)
+				ErrorState::pixi_error("Error on line {}: Sprite number {:X} already used\n", lineno, sprite_id);
+			sprp = &sprites.sprites.emplace_back();
+			m_perlevel_sprites.insert(level, sprite_id, (int)sprites.sprites.size() - 1, *sprp);
+		}
+		else {
+			int slot = slot_of(sprite_id, type);
+			if (slot == INVALID_SLOT) {
+				if (type == ListType::Sprite)
 					ErrorState::pixi_error("Error on line {}: Sprite number must be less than 0x100\n", lineno);
-				if (level > 0x200)
-					ErrorState::pixi_error("Error on line {}: Level must range from 000-1FF\n", lineno);
-				if (sprite_id >= 0xB0 && sprite_id < 0xC0)
-					ErrorState::pixi_error("Error on line {}: Only sprite B0-BF must be assigned a level.\n", lineno);
-			}
-			else {
-				if (sprite_id > Sprite::SPRITE_COUNT)
-					ErrorState::pixi_error("Error on line {}: Sprite number must be less than {:X}\n", lineno, Sprite::SPRITE_COUNT);
+				ErrorState::pixi_error("Error on line {}: Sprite number must be less than {:X}\n", lineno, Sprite::SPRITE_COUNT);
 			}
+			if (sprites.store.owner(slot) != SpriteTableStore::EMPTY)
+				ErrorState::pixi_error("Error on line {}: Sprite number {:X} already used\n", lineno, sprite_id);
+			sprp = &sprites.sprites.emplace_back();
+			sprites.store.bind(slot, (int)sprites.sprites.size() - 1, *sprp);
 		}
-		if (spr.line)
-			ErrorState::pixi_error("Error on line {}: Sprite number {:X} already used\n", lineno, sprite_id);
+		Sprite& spr = *sprp;
 		spr.line = lineno;
 		spr.level = level;
 		spr.number = sprite_id;
@@ -184,70 +201,61 @@ void SpritesData::populate(PixiConfig& cfg)
 			fmt::print("\n--------------------------------------\n");
 		}
 
-		if (!spr.table.type) {
-			spr.table.init = Pointer(Sprite::INIT_PTR + 2 * spr.number);
-			spr.table.main = Pointer(Sprite::MAIN_PTR + 2 * spr.number);
-		}
+		set_default_pointers(spr);
 	}
 }
 
+// count records of stride bytes, as stride arrays of count bytes: byte k of record i goes to k * count + i
+static void write_planar(const uint8_t* records, size_t count, size_t stride, MemoryFile& file) {
+	std::vector<uint8_t> planes(count * stride);
+	for (size_t i = 0; i < count; i++)
+		for (size_t k = 0; k < stride; k++)
+			planes[k * count + i] = records[i * stride + k];
+	file.insertBytes(planes.data(), planes.size());
+}
+
 void SpritesData::serialize(const PixiConfig& cfg, SpriteMemoryFiles& files)
 {
 	DEBUGMSG("Try create binary tables\n");
 	files.SetPath(cfg.m_Paths[PathType::Asm]);
 	MemoryFile& version = files[SpriteFile::Version];
-	MemoryFile& perlevellvlptrs = files[SpriteFile::Perlevellvlptrs];
-	MemoryFile& perlevelsprptrs = files[SpriteFile::Perlevelsprptrs];
-	MemoryFile& perlevelt = files[SpriteFile::Perlevelt];
-	MemoryFile& perlevelcustomptrtable = files[SpriteFile::Perlevelcustomptrtable];
 	MemoryFile& defaulttables = files[SpriteFile::Defaulttables];
 	MemoryFile& customstatusptr = files[SpriteFile::Customstatusptr];
 	MemoryFile& clusterptr = files[SpriteFile::Clusterptr];
 	MemoryFile& extendedptr = files[SpriteFile::Extendedptr];
 	MemoryFile& extendedcapeptr = files[SpriteFile::Extendedcapeptr];
 	MemoryFile& customsize = files[SpriteFile::Customsize];
-	write_all(cfg.versionflag, version, 4);
-	if (cfg.PerLevel) {
-		write_all(pls_data.level_ptrs, perlevellvlptrs, 0x400);
-		if (pls_data.data_addr == 0) {
-			ByteArray<uint8_t, 1> dummy{ 0xFF };
-			write_all(dummy, perlevelsprptrs, 1);
-			write_all(dummy, perlevelt, 1);
-			write_all(dummy, perlevelcustomptrtable, 1);
-		}
-		else {
-			write_all(pls_data.sprite_ptrs, perlevelsprptrs, pls_data.sprite_ptrs_addr);
-			write_all(pls_data.data, perlevelt, pls_data.data_addr);
-			write_all(pls_data.pls_pointers, perlevelcustomptrtable, pls_data.data_addr);
-			DEBUGFMTMSG("Per-level sprites data size : 0x400+0x{:04X}+2*0x{:04X} = {:04X}\n", pls_data.sprite_ptrs_addr,
-				pls_data.data_addr, 0x400 + pls_data.sprite_ptrs_addr + 2 * pls_data.data_addr);
-		}
-		write_long_table(normal().cbegin() + 0x2000, defaulttables);
-	}
-	else {
-		write_long_table(normal().cbegin(), defaulttables);
-	}
-
-	ByteArray<uint8_t, 0x100 * 15> customstatusptrs{};
-	for (int i = 0, j = cfg.PerLevel ? 0x2000 : 0; i < 0x100 * 5; i += 5, j++) {
-		memcpy(customstatusptrs.ptr_at(i * 3), &normal()[j].ptrs, 15);
-	}
-	write_all(customstatusptrs, customstatusptr, 0x100 * 15);
+	auto version_flags = cfg.version_flags();
+	version.insertBytes(version_flags.data(), version_flags.size());
+	if (cfg.PerLevel)
+		serialize_perlevel(cfg, files);
+	write_long_table(normal().store, 0, defaulttables);
+	// planar, each of the 5 status pointers of the sprites gets its low, high and bank array of 0x100 bytes
+	if (cfg.PlanarPointers)
+		write_planar(normal().store.ptrs_bytes(0), 0x100, sizeof(StatusPointers), customstatusptr);
+	else
+		customstatusptr.insertBytes(normal().store.ptrs_bytes(0), 0x100 * sizeof(StatusPointers));
 
 	ByteArray<uint8_t, Sprite::SPRITE_COUNT * 3> file{};
 	for (int i = 0; i < Sprite::SPRITE_COUNT; i++) {
-		memcpy(file.ptr_at(i * 3), &cluster()[i].table.main, 3);
+		memcpy(file.ptr_at(i * 3), &cluster().store.table(i).main, 3);
 	}
-	write_all(file, clusterptr, Sprite::SPRITE_COUNT * 3);
+	if (cfg.PlanarPointers)
+		write_planar(file.start(), Sprite::SPRITE_COUNT, 3, clusterptr);
+	else
+		write_all(file, clusterptr, Sprite::SPRITE_COUNT * 3);
 
 	for (int i = 0; i < Sprite::SPRITE_COUNT; i++) {
-		memcpy(file.ptr_at(i * 3), &extended()[i].table.main, 3);
+		memcpy(file.ptr_at(i * 3), &extended().store.table(i).main, 3);
 	}
-	write_all(file, extendedptr, Sprite::SPRITE_COUNT * 3);
-	for (int i = 0; i < Sprite::SPRITE_COUNT; i++) {
-		memcpy(file.ptr_at(i * 3), &extended()[i].extended_cape_ptr, 3);
+	if (cfg.PlanarPointers) {
+		write_planar(file.start(), Sprite::SPRITE_COUNT, 3, extendedptr);
+		write_planar(extended().store.cape_ptrs_bytes(0), Sprite::SPRITE_COUNT, sizeof(Pointer), extendedcapeptr);
+	}
+	else {
+		write_all(file, extendedptr, Sprite::SPRITE_COUNT * 3);
+		extendedcapeptr.insertBytes(extended().store.cape_ptrs_bytes(0), Sprite::SPRITE_COUNT * sizeof(Pointer));
 	}
-	write_all(file, extendedcapeptr, Sprite::SPRITE_COUNT * 3);
 
 	DEBUGMSG("Binary tables created\n");
 
@@ -256,21 +264,83 @@ void SpritesData::serialize(const PixiConfig& cfg, SpriteMemoryFiles& files)
 	write_all(extra_bytes, customsize, 0x200);
 }
 
+void SpritesData::serialize_perlevel(const PixiConfig& cfg, SpriteMemoryFiles& files)
+{
+	MemoryFile& perlevellvlptrs = files[SpriteFile::Perlevellvlptrs];
+	MemoryFile& perlevelsprptrs = files[SpriteFile::Perlevelsprptrs];
+	MemoryFile& perlevelt = files[SpriteFile::Perlevelt];
+	MemoryFile& perlevelcustomptrtable = files[SpriteFile::Perlevelcustomptrtable];
+
+	// level -> 0x20 bytes of sprite pointers, only levels that have sprites get a block
+	// every pointer is stored +1 so that 0x0000 means "no sprites"
+	ByteArray<uint8_t, 0x400> level_ptrs{};
+	std::vector<uint8_t> sprite_ptrs{};
+	// table + status pointers of a record -> its offset, identical records are stored only once
+	std::unordered_map<std::string, int> records{};
+	int data_addr = 0;
+	int last_level = -1;
+	auto entries = m_perlevel_sprites.sorted_entries();
+	for (size_t entry : entries) {
+		int level = m_perlevel_sprites.level(entry);
+		if (level != last_level) {
+			int lv_addr = (int)sprite_ptrs.size() + 1;
+			level_ptrs[level * 2] = (uint8_t)lv_addr;
+			level_ptrs[level * 2 + 1] = (uint8_t)(lv_addr >> 8);
+			sprite_ptrs.resize(sprite_ptrs.size() + 0x20);
+			last_level = level;
+		}
+
+		std::string record{};
+		record.append(reinterpret_cast<const char*>(m_perlevel_sprites.table_bytes(entry)), sizeof(SpriteTable));
+		record.append(reinterpret_cast<const char*>(m_perlevel_sprites.ptrs_bytes(entry)), sizeof(StatusPointers));
+		auto [it, inserted] = records.try_emplace(std::move(record), data_addr);
+		if (inserted) {
+			if (data_addr >= 0x8000)
+				ErrorState::pixi_error("Too many Per-Level sprites. Please remove some.\n");
+			perlevelt.insertBytes(m_perlevel_sprites.table_bytes(entry), sizeof(SpriteTable));
+			perlevelcustomptrtable.insertBytes(m_perlevel_sprites.ptrs_bytes(entry), sizeof(StatusPointers));
+			perlevelcustomptrtable.insertBytes("\xFF", 1);
+			data_addr += 0x10;
+		}
+
+		size_t spr_addr = sprite_ptrs.size() - 0x20 + (m_perlevel_sprites.number(entry) - 0xB0) * 2;
+		sprite_ptrs[spr_addr] = (uint8_t)(it->second + 1);
+		sprite_ptrs[spr_addr + 1] = (uint8_t)((it->second + 1) >> 8);
+	}
+
+	write_all(level_ptrs, perlevellvlptrs, 0x400);
+	if (data_addr == 0) {
+		ByteArray<uint8_t, 1> dummy{ 0xFF };
+		write_all(dummy, perlevelsprptrs, 1);
+		write_all(dummy, perlevelt, 1);
+		write_all(dummy, perlevelcustomptrtable, 1);
+	}
+	else {
+		perlevelsprptrs.insertBytes(sprite_ptrs.data(), sprite_ptrs.size());
+		DEBUGFMTMSG("Per-level sprites data size : 0x400+0x{:04X}+2*0x{:04X} = {:04X}\n", sprite_ptrs.size(),
+			data_addr, 0x400 + sprite_ptrs.size() + 2 * data_addr);
+		if (cfg.Debug) {
+			size_t shared = entries.size() - records.size();
+			fmt::print("Per-level sprites: {} entries, {} unique records, {} shared ({} bytes saved)\n",
+				entries.size(), records.size(), shared, shared * 2 * 0x10);
+		}
+	}
+}
+
 void SpritesData::serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0x200>& extra_bytes) {
-	std::vector<Map16> map{};
-	map.reserve(MAP16_SIZE);
+	Map16Pool map{};
 	DEBUGMSG("Try create romname files.\n");
-	FILE* s16 = open_subfile(cfg.RomName, "s16", "wb");
-	FILE* ssc = open_subfile(cfg.RomName, "ssc", "w");
-	FILE* mwt = open_subfile(cfg.RomName, "mwt", "w");
-	FILE* mw2 = open_subfile(cfg.RomName, "mw2", "wb");
-	DEBUGMSG("Romname files opened.\n");
+	// the files are built in memory and only written if they changed, so Lunar Magic doesn't reload them needlessly
+	MemoryFile s16{ subfile_name(cfg.RomName, "s16"), false };
+	MemoryFile ssc{ subfile_name(cfg.RomName, "ssc"), false };
+	MemoryFile mwt{ subfile_name(cfg.RomName, "mwt"), false };
+	MemoryFile mw2{ subfile_name(cfg.RomName, "mw2"), false };
 
 	if (!cfg.m_Extensions[ExtType::Ssc].empty()) {
 		std::ifstream fin(cfg.m_Extensions[ExtType::Ssc]);
 		std::string line;
 		while (std::getline(fin, line)) {
-			fmt::print(ssc, "{}\n", line);
+			ssc.insertString("{}\n", line);
 		}
 		fin.close();
 	}
@@ -278,7 +348,7 @@ void SpritesData::serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0
 		std::ifstream fin(cfg.m_Extensions[ExtType::Mwt]);
 		std::string line;
 		while (std::getline(fin, line)) {
-			fmt::print(mwt, "{}\n", line);
+			mwt.insertString("{}\n", line);
 		}
 		fin.close();
 	}
@@ -287,7 +357,7 @@ void SpritesData::serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0
 		size_t fs_size = filesize(fp);
 		if (fs_size == 0) {
 			// if size == 0, it means that the file is empty, so we just append the 0x00 and go on with our lives
-			fputc(0x00, mw2);
+			mw2.insertBytes("\x00", 1);
 		}
 		else {
 			fs_size--; // -1 to skip the 0xFF byte at the end
@@ -295,109 +365,121 @@ void SpritesData::serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0
 			auto read_size = mw2_data.from_file(fp);
 			if (read_size != fs_size)
 				ErrorState::pixi_error("Couldn't fully read file {}, please check file permissions", cfg.m_Extensions[ExtType::Mw2]);
-			fwrite(mw2_data.start(), 1, fs_size, mw2);
+			mw2.insertBytes(mw2_data.start(), fs_size);
 		}
 		fclose(fp);
 	}
 	else {
-		fputc(0x00, mw2); // binary data starts with 0x00
+		mw2.insertBytes("\x00", 1); // binary data starts with 0x00
 	}
 	if (!cfg.m_Extensions[ExtType::S16].empty()) {
 		FILE* fp = fileopen(cfg.m_Extensions[ExtType::S16].c_str(), "rb");
 		ByteArray<uint8_t, 1> s16_data{};
 		s16_data.from_file(fp);
 		for (auto iter = s16_data.cbegin(); iter != s16_data.cend(); iter += sizeof(Map16)) {
-			map.emplace_back(iter);
+			map.append(Map16{ iter });
 		}
 		fclose(fp);
 	}
 	for (int i = 0; i < 0x100; i++) {
-		Sprite& spr = from_table(normal(), 0x200, i, cfg.PerLevel, ListType::Sprite);
+		int slot = slot_of(i, ListType::Sprite);
 
-		if (spr.invalid || (cfg.PerLevel && i >= 0xB0 && i < 0xC0)) {
+		if (cfg.PerLevel && i >= 0xB0 && i < 0xC0) {
 			extra_bytes[i] = 7;
 			extra_bytes[i + 0x100] = 7;
 		}
 		else {
-			if (spr.line) {
+			if (normal().store.owner(slot) != SpriteTableStore::EMPTY) {
+				Sprite& spr = normal().at_slot(slot);
 				extra_bytes[i] = (uint8_t)(3 + spr.byte_count);
 				extra_bytes[i + 0x100] = (uint8_t)(3 + spr.extra_byte_count);
 
-				if (map.size() + spr.map_data.size() > MAP16_SIZE) {
+				// pool index of every block of the sprite, a sprite whose blocks are already stored in a row reuses them as they are
+				auto map_offset = map.size();
+				std::vector<size_t> remap{};
+				remap.reserve(spr.map_data.size());
+				if (auto run = map.find_run(spr.map_data)) {
+					for (size_t j = 0; j < spr.map_data.size(); j++)
+						remap.push_back(*run + j);
+				}
+				else {
+					for (const Map16& block : spr.map_data)
+						remap.push_back(map.intern(block));
+				}
+				if (map.size() > MAP16_SIZE) {
 					ErrorState::pixi_error("There wasn't enough space in your s16 file to fit everything, was trying to fit {} blocks, "
 						"couldn't find space\n", spr.map_data.size());
 				}
-				auto map_offset = map.size();
-				std::for_each(spr.map_data.cbegin(), spr.map_data.cend(), [&map](const Map16& block) mutable {
-					map.emplace_back(block);
-					});
 				for (auto& dis : spr.displays) {
 					int ref = 0;
 					if (spr.display_type == DisplayType::ExtensionByte) {
 						ref = 0x20 + (dis.extra_bit ? 0x10 : 0);
 						if (dis.description.empty()) {
-							fmt::print(ssc, "{:02X} {:1X}{:02X}{:02X} {}\n", i, dis.x_or_index, dis.y_or_value, ref, spr.asm_file);
+							ssc.insertString("{:02X} {:1X}{:02X}{:02X} {}\n", i, dis.x_or_index, dis.y_or_value, ref, spr.asm_file);
 						}
 						else {
-							fmt::print(ssc, "{:02X} {:1X}{:02X}{:02X} {}\n", i, dis.x_or_index, dis.y_or_value, ref, dis.description);
+							ssc.insertString("{:02X} {:1X}{:02X}{:02X} {}\n", i, dis.x_or_index, dis.y_or_value, ref, dis.description);
 						}
 					}
 					else {
 						ref = dis.y_or_value * 0x1000 + dis.x_or_index * 0x100 + 0x20 + (dis.extra_bit ? 0x10 : 0);
 						if (dis.description.empty()) {
-							fmt::print(ssc, "{:02X} {:04X} {}\n", i, ref, spr.asm_file);
+							ssc.insertString("{:02X} {:04X} {}\n", i, ref, spr.asm_file);
 						}
 						else {
-							fmt::print(ssc, "{:02X} {:04X} {}\n", i, ref, dis.description);
+							ssc.insertString("{:02X} {:04X} {}\n", i, ref, dis.description);
 						}
 					}
 
 					if (dis.gfx_files.size() > 0) {
-						fmt::print(ssc, "{:02X} 8 ", i);
+						ssc.insertString("{:02X} 8 ", i);
 						for (auto& gfx : dis.gfx_files) {
-							fmt::print(ssc, "{:X},{:X},{:X},{:X} ",
+							ssc.insertString("{:X},{:X},{:X},{:X} ",
 								gfx.gfx_files[0],
 								gfx.gfx_files[1],
 								gfx.gfx_files[2],
 								gfx.gfx_files[3]);
 						}
-						fmt::print(ssc, "\n");
+						ssc.insertString("\n");
 					}
 
 					if (spr.display_type == DisplayType::ExtensionByte) {
-						fmt::print(ssc, "{:02X} {:1X}{:02X}{:02X}", i, dis.x_or_index, dis.y_or_value, ref + 2);
+						ssc.insertString("{:02X} {:1X}{:02X}{:02X}", i, dis.x_or_index, dis.y_or_value, ref + 2);
 					}
 					else {
-						fmt::print(ssc, "{:02X} {:04X}", i, ref + 2);
+						ssc.insertString("{:02X} {:04X}", i, ref + 2);
 					}
 
 					for (auto& tile : dis.tiles) {
 						if (!tile.text.empty()) {
-							fmt::print(ssc, " 0,0,*{}*", tile.text);
+							ssc.insertString(" 0,0,*{}*", tile.text);
 							break;
 						}
 						else {
 							int tile_num = tile.tile_number;
-							if (tile_num >= 0x300)
-								tile_num += 0x100 + map_offset;
-							fmt::print(ssc, " {},{},{:X}", tile.x_offset, tile.y_offset, tile_num);
+							if (tile_num >= 0x300) {
+								size_t index = (size_t)(tile_num - 0x300);
+								if (index < remap.size())
+									tile_num = 0x400 + (int)remap[index];
+								else
+									tile_num += 0x100 + (int)map_offset;
+							}
+							ssc.insertString(" {},{},{:X}", tile.x_offset, tile.y_offset, tile_num);
 						}
 					}
-					fmt::print(ssc, "\n");
+					ssc.insertString("\n");
 				}
 
 				int j = 0;
 				for (auto& c : spr.collections) {
-					char b = 0x79 + (c.extra_bit ? 0x04 : 0);
-					fputc(b, mw2);
-					fputc(0x70, mw2);
-					fputc(spr.number, mw2);
+					uint8_t header[3] = { (uint8_t)(0x79 + (c.extra_bit ? 0x04 : 0)), 0x70, (uint8_t)spr.number };
+					mw2.insertBytes(header, sizeof(header));
 					int byte_count = (c.extra_bit ? spr.extra_byte_count : spr.byte_count);
-					fwrite(c.prop, 1, byte_count, mw2);
+					mw2.insertBytes(c.prop, byte_count);
 					if (j == 0)
-						fmt::print(mwt, "{:02X}\t{}\n", spr.number, c.name);
+						mwt.insertString("{:02X}\t{}\n", spr.number, c.name);
 					else
-						fmt::print(mwt, "\t{}\n", c.name);
+						mwt.insertString("\t{}\n", c.name);
 					j++;
 				}
 			}
@@ -407,41 +489,93 @@ void SpritesData::serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0
 			}
 		}
 	}
-	fputc(0xFF, mw2);
-	map.insert(map.cbegin() + map.size(), map.capacity() - map.size(), {});
-	fwrite(map.data(), sizeof(Map16), map.size(), s16);
-	fclose(s16);
-	fclose(ssc);
-	fclose(mwt);
-	fclose(mw2);
+	mw2.insertBytes("\xFF", 1);
+	std::vector<Map16> blocks = map.blocks();
+	if (blocks.size() < MAP16_SIZE)
+		blocks.resize(MAP16_SIZE);
+	s16.insertBytes(reinterpret_cast<const uint8_t*>(blocks.data()), blocks.size() * sizeof(Map16));
+
+	for (MemoryFile* file : { &s16, &ssc, &mwt, &mw2 }) {
+		if (file->WriteIfChanged()) {
+			DEBUGFMTMSG("{} written\n", file->Path());
+		}
+		else {
+			DEBUGFMTMSG("{} unchanged\n", file->Path());
+		}
+	}
 }
 
-void SpritesData::write_long_table(Svect::const_iterator spr, MemoryFile& path)
+void SpritesData::write_long_table(const SpriteTableStore& store, size_t first_slot, MemoryFile& path)
 {
 	static ByteArray<uint8_t, 0x10> dummy{ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
-	ByteArray<uint8_t, 0x100 * 0x10> file{};
-	if (is_empty_table(spr, 0x100)) {
+	if (is_empty_table(store, first_slot, 0x100)) {
 		write_all(dummy, path, 0x10);
 	}
 	else {
-		for (int i = 0; i < 0x100; i++) {
-			memcpy(file.ptr_at(i * 0x10), &spr[i].table, 0x10);
-		}
-		write_all(file, path, 0x100 * 0x10);
+		path.insertBytes(store.table_bytes(first_slot), 0x100 * sizeof(SpriteTable));
 	}
 }
 
-bool SpritesData::is_empty_table(Svect::const_iterator spr, int size) {
-	for (int i = 0; i < size; i++) {
-		if (!spr[i].table.init.is_empty() || !spr[i].table.main.is_empty())
+bool SpritesData::is_empty_table(const SpriteTableStore& store, size_t first_slot, size_t size) {
+	for (size_t i = first_slot; i < first_slot + size; i++) {
+		if (!store.table(i).init.is_empty() || !store.table(i).main.is_empty())
 			return false;
 	}
 	return true;
 }
 
+bool SpritesData::reparse(const std::string& cfg_file, PixiConfig& cfg)
+{
+	bool listed = false;
+	for (Sprite& spr : m_normal_sprites.sprites) {
+		if (spr.cfg_file != cfg_file)
+			continue;
+		if (!listed) {
+			// the warnings of the previous parse name the file, parsing it again adds them back
+			std::string quoted = "\"" + std::filesystem::path(cfg_file).filename().generic_string() + "\"";
+			auto& warnings = cfg.WarningList;
+			warnings.erase(std::remove_if(warnings.begin(), warnings.end(), [&quoted](const std::string& warning) {
+				return warning.find(quoted) != std::string::npos;
+				}), warnings.end());
+		}
+		listed = true;
+		*spr.table = SpriteTable{};
+		*spr.ptrs = StatusPointers{};
+		*spr.extended_cape_ptr = Pointer{};
+		spr.byte_count = 0;
+		spr.extra_byte_count = 0;
+		spr.asm_file.clear();
+		spr.map_data.clear();
+		spr.displays.clear();
+		spr.collections.clear();
+		spr.display_type = DisplayType::XYPosition;
+		spr.parse(cfg);
+		set_default_pointers(spr);
+	}
+	return listed;
+}
+
+std::vector<std::string> SpritesData::source_files(const std::vector<std::string>& extraDefines)
+{
+	std::vector<std::string> files{ extraDefines };
+	std::set<std::string_view> seen{};
+	for (SpriteList* list : { &normal(), &cluster(), &extended() }) {
+		for (const Sprite& spr : list->sprites) {
+			if (spr.asm_file.empty())
+				continue;
+			if (seen.insert(spr.asm_file).second)
+				files.push_back(spr.asm_file);
+			std::string header = spr.directory + "_header.asm";
+			if (std::find(files.begin(), files.end(), header) == files.end())
+				files.push_back(std::move(header));
+		}
+	}
+	return files;
+}
+
 void SpritesData::patch_sprites_wrap(const std::vector<std::string>& extraDefines, PixiConfig& cfg)
 {
-	patch_sprites(extraDefines, normal(), normal().size(), cfg);
-	patch_sprites(extraDefines, cluster(), cluster().size(), cfg);
-	patch_sprites(extraDefines, extended(), extended().size(), cfg);
+	patch_sprites(extraDefines, normal(), cfg);
+	patch_sprites(extraDefines, cluster(), cfg);
+	patch_sprites(extraDefines, extended(), cfg);
 }
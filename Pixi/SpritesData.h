@@ -1,80 +1,113 @@
 #pragma once
+#include <unordered_map>
+#include <optional>
 #include "MeiMei/MeiMei.h"
 
-struct PerLevelData {
-	int sprite_ptrs_addr = 0;
-	int data_addr = 0;
-	ByteArray<uint8_t, 0x400> level_ptrs{};
-	ByteArray<uint8_t, 0x4000> sprite_ptrs{};
-	ByteArray<uint8_t, 0x8000> data{};
-	ByteArray<uint8_t, 0x8000> pls_pointers{};
-	PerLevelData(PerLevelData&& other) = delete;
+// a list of sprites of the same type: hot tables indexed by slot and the cold data of the listed sprites
+struct SpriteList {
+	SpriteTableStore store;
+	std::vector<Sprite> sprites{};
+
+	SpriteList(size_t slots) : store(slots) {}
+
+	Sprite& at_slot(size_t slot) {
+		return sprites[store.owner(slot)];
+	}
+};
+
+// map16 blocks of the generated s16 file, identical blocks and runs of blocks are only stored once
+class Map16Pool {
+	std::vector<Map16> m_blocks{};
+	// block contents -> every position where it's stored
+	std::unordered_map<uint64_t, std::vector<size_t>> m_index{};
+public:
+	size_t size() const { return m_blocks.size(); }
+	const std::vector<Map16>& blocks() const { return m_blocks; }
+
+	size_t append(const Map16& block);
+	size_t intern(const Map16& block);
+	std::optional<size_t> find_run(const std::vector<Map16>& run) const;
 };
 
 class SpritesData {
-	using Svect = std::vector<Sprite>;
 private:
 	constexpr static inline auto MAP16_SIZE = 0x3800;
-	Rom& m_rom;
-	Svect m_normal_sprites{};
-	Svect m_cluster_sprites{};
-	Svect m_extended_sprites{};
-	Svect m_ow_sprites{};
-	PerLevelData pls_data{};
-	std::array<Svect*, FromEnum(ListType::SIZE)> sprites_list{&m_normal_sprites, &m_extended_sprites, &m_cluster_sprites, &m_ow_sprites};
-	void patch_sprites(const std::vector<std::string>& extraDefines, Svect& sprites, size_t size, PixiConfig& cfg);
+	constexpr static inline int INVALID_SLOT = -1;
+	Rom* m_rom = nullptr;
+	SpriteList m_normal_sprites{ 0x100 };
+	SpriteList m_cluster_sprites{ Sprite::SPRITE_COUNT };
+	SpriteList m_extended_sprites{ Sprite::SPRITE_COUNT };
+	SpriteList m_ow_sprites{ 0 };
+	PerLevelSprites m_perlevel_sprites{};
+	std::array<SpriteList*, FromEnum(ListType::SIZE)> sprites_list{&m_normal_sprites, &m_extended_sprites, &m_cluster_sprites, &m_ow_sprites};
+	using InsertedSprites = std::unordered_map<std::string_view, const Sprite*>;
+	void patch_sprite_shared(Sprite& spr, InsertedSprites& inserted, const std::vector<std::string>& extraDefines, PixiConfig& cfg);
+	void patch_sprites(const std::vector<std::string>& extraDefines, SpriteList& sprites, PixiConfig& cfg);
+	void serialize_perlevel(const PixiConfig& cfg, SpriteMemoryFiles& files);
+	int slot_of(int number, ListType type) const;
 	SpritesData(SpritesData&& other) = delete;
 public:
-	SpritesData(Rom& rom, const PixiConfig& cfg) : m_rom(rom) {
-		m_normal_sprites.reserve(cfg.PerLevel ? Sprite::MAX_SPRITE_COUNT : 0x100);
-		m_normal_sprites.insert(m_normal_sprites.begin(), cfg.PerLevel ? Sprite::MAX_SPRITE_COUNT : 0x100, {});
-		m_cluster_sprites.reserve(Sprite::SPRITE_COUNT);
-		m_cluster_sprites.insert(m_cluster_sprites.begin(), Sprite::SPRITE_COUNT, {});
-		m_extended_sprites.reserve(Sprite::SPRITE_COUNT);
-		m_extended_sprites.insert(m_extended_sprites.begin(), Sprite::SPRITE_COUNT, {});
-		m_ow_sprites.reserve(Sprite::SPRITE_COUNT);
+	SpritesData(const PixiConfig&) {
+		m_normal_sprites.sprites.reserve(0x100);
+		m_cluster_sprites.sprites.reserve(Sprite::SPRITE_COUNT);
+		m_extended_sprites.sprites.reserve(Sprite::SPRITE_COUNT);
+	}
+
+	SpritesData(Rom& rom, const PixiConfig& cfg) : SpritesData(cfg) {
+		m_rom = &rom;
+	}
+
+	// the list doesn't depend on the rom, so it can be populated before the rom to insert into is known
+	void set_rom(Rom& rom) {
+		m_rom = &rom;
 	}
 
 	void populate(PixiConfig& cfg);
+	// parses cfg_file again for every sprite listed with it, the list itself must be unchanged
+	// returns false if no listed sprite uses it
+	bool reparse(const std::string& cfg_file, PixiConfig& cfg);
 	void serialize(const PixiConfig& cfg, SpriteMemoryFiles& files);
 	void serialize_subfiles(const PixiConfig& cfg, ByteArray<uint8_t, 0x200>& extra_bytes);
-	void write_long_table(Svect::const_iterator spr, MemoryFile& path);
-	bool is_empty_table(Svect::const_iterator spr, int size);
+	void write_long_table(const SpriteTableStore& store, size_t first_slot, MemoryFile& path);
+	bool is_empty_table(const SpriteTableStore& store, size_t first_slot, size_t size);
 	void patch_sprites_wrap(const std::vector<std::string>& extraDefines, PixiConfig& cfg);
+	// every file that's assembled with the sprites: their asm files, the _header.asm of their folders and the extra defines
+	std::vector<std::string> source_files(const std::vector<std::string>& extraDefines);
 
-	Svect& operator[](int index) {
+	SpriteList& operator[](int index) {
 		assert(index < FromEnum(ListType::SIZE));
 		return *sprites_list[index];
 	}
 
-	Svect& operator[](ListType index) {
+	SpriteList& operator[](ListType index) {
 		assert(index < ListType::SIZE);
 		return *sprites_list[FromEnum(index)];
 	}
 
 	template <typename T, typename = std::enable_if_t<std::is_same<T, ListType>::value || std::is_same<T, int>::value>>
-	Svect& get(T index) {
+	SpriteList& get(T index) {
 		return this->operator[](index);
 	}
 
-	Svect& normal() {
+	SpriteList& normal() {
 		return m_normal_sprites;
 	}
 
-	Svect& cluster() {
+	SpriteList& cluster() {
 		return m_cluster_sprites;
 	}
 
-	Svect& extended() {
+	SpriteList& extended() {
 		return m_extended_sprites;
 	}
 
-	Svect& overworld() {
+	SpriteList& overworld() {
 		return m_ow_sprites;
 	}
 
 	Rom& rom() {
-		return m_rom;
+		assert(m_rom != nullptr);
+		return *m_rom;
 	}
 
 };
\ No newline at end of file
@@ -24,7 +24,7 @@ private:
 		}
 	};
 	struct patchparams* params = nullptr;
-	size_t n_files;
+	size_t n_files = 0;
 	std::vector<std::pair<const void*, size_t>> file_data;
 	std::vector<std::string_view> file_paths;
 	std::vector<definedata> m_defines;
@@ -50,8 +50,9 @@ private:
 		params->warning_settings = setting;
 		params->warning_setting_count = 2;
 
-		params->override_checksum_gen = false;
-		params->generate_checksum = true;
+		// the checksum is fixed once by Rom::close, not after each of the patches
+		params->override_checksum_gen = true;
+		params->generate_checksum = false;
 	}
 
 	template <typename File, typename... Files>
@@ -87,6 +88,10 @@ public:
 		m_defines.insert(m_defines.cbegin(), defines.begin(), defines.end());
 	}
 
+	void add_defines(const std::vector<definedata>& defines) {
+		m_defines.insert(m_defines.cend(), defines.begin(), defines.end());
+	}
+
 	std::string_view PatchLoc() {
 		if (n_files > 0)
 			return file_paths[0];
@@ -1,4 +1,5 @@
 #include "Util.h"
+#include <array>
 
 #ifdef WIN32
 void double_click_exit() {
@@ -19,6 +20,10 @@ void wait_before_exit(int arguments)
 #endif
 }
 
+void array_index_error(size_t size, size_t index) {
+	ErrorState::pixi_error("[ ARRAY ] Trying to access array of size {} with index of size {}\n", size, index);
+}
+
 std::string ask(const char* prompt) {
 	char buffer[1024];
 	puts(prompt);
@@ -112,12 +117,78 @@ std::string escapeDefines(std::string_view path, const char* repl) {
 	return ss.str();
 }
 
+std::string subfile_name(const std::string& name, const char* ext)
+{
+	return name.substr(0, name.find_last_of('.') + 1) + ext;
+}
+
 FILE* open_subfile(const std::string& name, const char* ext, const char* mode)
 {
-	std::string filename = name.substr(0, name.find_last_of('.') + 1) + ext;
+	std::string filename = subfile_name(name, ext);
 	return fileopen(filename.c_str(), mode);
 }
 
+uint64_t fnv1a_hash(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc)
+{
+	static const auto table = []() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t value = i;
+			for (int bit = 0; bit < 8; bit++)
+				value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+			table[i] = value;
+		}
+		return table;
+	}();
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+// compares the file on disk (if any) with the data, the file is streamed through the hash so it's never fully loaded
+std::optional<uint64_t> file_hash(const std::string& filename)
+{
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (fp == nullptr)
+		return std::nullopt;
+	uint64_t hash = fnv1a_hash(nullptr, 0);
+	char buf[0x4000];
+	size_t read = 0;
+	while ((read = fread(buf, 1, sizeof(buf), fp)) > 0)
+		hash = fnv1a_hash(buf, read, hash);
+	fclose(fp);
+	return hash;
+}
+
+bool file_content_equals(const std::string& filename, const char* mode, const void* data, size_t size)
+{
+	FILE* fp = fopen(filename.c_str(), mode);
+	if (fp == nullptr)
+		return false;
+	uint64_t hash = fnv1a_hash(nullptr, 0);
+	size_t total = 0;
+	char buf[0x4000];
+	size_t read = 0;
+	while ((read = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		hash = fnv1a_hash(buf, read, hash);
+		total += read;
+	}
+	fclose(fp);
+	return total == size && hash == fnv1a_hash(data, size);
+}
+
 size_t filesize(FILE* fp)
 {
 	fseek(fp, 0, SEEK_END);
@@ -6,8 +6,10 @@
 #include <windows.h>
 #endif
 #include <filesystem>
+#include <optional>
 #include <cstdio>
 #include <string_view>
+#include <stdexcept>
 #include "fmt/fmt/format.h"
 #include "fmt/fmt/color.h"
 #include "asar/asardll.h"
@@ -21,51 +23,96 @@ std::string cleanPathTrail(std::string path);
 void set_paths_relative_to(std::string& path, std::string_view arg0);
 std::string append_to_dir(std::string_view src, std::string_view file);
 std::string escapeDefines(std::string_view path, const char* repl = "\\!");
+std::string subfile_name(const std::string& name, const char* ext);
 FILE* open_subfile(const std::string& name, const char* ext, const char* mode);
+uint64_t fnv1a_hash(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325);
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+// fnv1a hash of the whole file, empty if it can't be opened
+std::optional<uint64_t> file_hash(const std::string& filename);
+bool file_content_equals(const std::string& filename, const char* mode, const void* data, size_t size);
 size_t filesize(FILE* fp);
 bool ends_with(const char* str, const char* suffix);
 
+// thrown by ErrorState::pixi_error, whoever runs the insertion decides what to do with it
+// (the executable exits with 1, the library returns an error code)
+class PixiException : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+enum class MessageKind : int {
+	Error,
+	Warning
+};
+
 class ErrorState {
 	inline static bool asar_inited = false;
 public:
+	using MessageHandler = void (*)(MessageKind kind, const char* message, void* user_data);
+	// when set, errors and warnings go here instead of being printed
+	inline static MessageHandler message_handler = nullptr;
+	inline static void* message_user_data = nullptr;
+	// a library session keeps asar loaded between insertions
+	inline static bool keep_asar_loaded = false;
 
 	static bool asar_init_wrap() {
 		asar_inited = asar_init();
 		return asar_inited;
 	}
 	static void asar_close_wrap() {
+		if (keep_asar_loaded)
+			return;
 		if (asar_inited) asar_close();
 		asar_inited = false;
 	}
 	template <typename ...Args>
-	static void pixi_error(const char* format, Args... args) {
+	[[noreturn]] static void pixi_error(const char* format, Args... args) {
+		std::string message = fmt::format(format, args...);
+		if (message_handler != nullptr) {
+			message_handler(MessageKind::Error, message.c_str(), message_user_data);
+		}
+		else {
 #ifndef WIN32
-		fmt::print(fg(fmt::color::crimson) | fmt::emphasis::bold, "[ Error ] ");
-		fmt::print(fg(fmt::color::crimson) | fmt::emphasis::bold, format, args...);
+			fmt::print(fg(fmt::color::crimson) | fmt::emphasis::bold, "[ Error ] ");
+			fmt::print(fg(fmt::color::crimson) | fmt::emphasis::bold, "{}", message);
 #else
-		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_INTENSITY);
-		fmt::print("[ Error ] ");
-		fmt::print(format, args...);
-		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED);
-
+			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_INTENSITY);
+			fmt::print("[ Error ] ");
+			fmt::print("{}", message);
+			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED);
 #endif
-		asar_close_wrap();
-		exit(1);
+		}
+		throw PixiException(message);
 	}
 
 	template <typename ...Args>
 	static void pixi_warning(const char* format, Args... args) {
+		std::string message = fmt::format(format, args...);
+		if (message_handler != nullptr) {
+			message_handler(MessageKind::Warning, message.c_str(), message_user_data);
+			return;
+		}
 #ifndef WIN32
 		fmt::print(fg(fmt::color::yellow) | fmt::emphasis::bold, "[ Warning ] ");
-		fmt::print(fg(fmt::color::yellow) | fmt::emphasis::bold, format, args...);
+		fmt::print(fg(fmt::color::yellow) | fmt::emphasis::bold, "{}", message);
 #else
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY);
 		fmt::print("[ Warning ] ");
-		fmt::print(format, args...);
+		fmt::print("{}", message);
 		SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), FOREGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_RED);
 #endif
 	}
 
+	// the first character of the user's answer to a question a warning asked, hosts that handle the messages
+	// themselves can't be asked so for them it's as if enter was pressed
+	static char read_answer() {
+		if (message_handler != nullptr)
+			return '\n';
+		char c = (char)getchar();
+		fflush(stdin);
+		return c;
+	}
+
 #ifdef DEBUG
 	template <typename ...Args>
 	static void debug(const char* format, Args... args) {
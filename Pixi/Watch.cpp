@@ -0,0 +1,319 @@
+#include "Pixi.h"
+#include "Watch.h"
+
+#ifndef __linux__
+
+int pixi_watch(int, char*[]) {
+	ErrorState::pixi_error("--watch is only supported on Linux\n");
+	return 1;
+}
+
+#else
+#include <csignal>
+#include <cerrno>
+#include <map>
+#include <set>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr int DEBOUNCE_MS = 250;
+static constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+static volatile sig_atomic_t stop_watching = 0;
+
+static void on_stop_signal(int) {
+	stop_watching = 1;
+}
+
+struct WatchedDir {
+	std::string path{};
+	// every source file in the folder counts as input
+	bool sources = false;
+	// otherwise only these file names do
+	std::set<std::string> names{};
+};
+
+static bool is_source_file(std::string_view name) {
+	for (const char* ext : { ".asm", ".ASM", ".cfg", ".CFG", ".json", ".JSON", ".bin", ".BIN" }) {
+		if (ends_with(name.data(), ext))
+			// files that pixi itself writes while inserting must not trigger another insertion
+			return !is_generated_file(name);
+	}
+	return false;
+}
+
+class Watcher {
+	int m_fd = -1;
+	std::map<std::string, WatchedDir> m_dirs{};
+	std::map<int, std::string> m_wds{};
+
+	static std::string dir_key(const std::filesystem::path& path) {
+		return cleanPathTrail(std::filesystem::absolute(path).lexically_normal().generic_string());
+	}
+
+	void add_dir(const std::filesystem::path& path, bool recursive) {
+		std::error_code ec{};
+		if (!std::filesystem::is_directory(path, ec))
+			return;
+		m_dirs[dir_key(path)].sources = true;
+		if (!recursive)
+			return;
+		for (auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+			if (entry.is_directory(ec))
+				m_dirs[dir_key(entry.path())].sources = true;
+		}
+	}
+
+	void add_file(const std::string& file) {
+		if (file.empty())
+			return;
+		std::filesystem::path path = std::filesystem::absolute(file);
+		m_dirs[dir_key(path.parent_path())].names.insert(path.filename().string());
+	}
+
+	void add_watch(const std::string& dir) {
+		int wd = inotify_add_watch(m_fd, dir.c_str(), WATCH_MASK);
+		if (wd >= 0)
+			m_wds[wd] = dir;
+	}
+
+public:
+	~Watcher() {
+		if (m_fd >= 0)
+			close(m_fd);
+	}
+
+	void setup(const PixiConfig& cfg) {
+		if (m_fd >= 0)
+			close(m_fd);
+		m_dirs.clear();
+		m_wds.clear();
+		m_fd = inotify_init1(IN_CLOEXEC);
+		if (m_fd < 0)
+			ErrorState::pixi_error("Couldn't initialize inotify: {}\n", strerror(errno));
+		for (int i = 0; i < FromEnum(PathType::SIZE); i++) {
+			if (i == FromEnum(PathType::List))
+				add_file(cfg.m_Paths[i]);
+			else
+				add_dir(cfg.m_Paths[i], true);
+		}
+		for (int i = 0; i < FromEnum(ExtType::SIZE); i++)
+			add_file(cfg.m_Extensions[i]);
+		add_file("pixi_conf.toml");
+		for (auto& [dir, watched] : m_dirs) {
+			watched.path = dir;
+			add_watch(dir);
+		}
+	}
+
+	size_t size() const { return m_wds.size(); }
+
+	// waits for changes to the inputs, then keeps collecting them until nothing changed for DEBOUNCE_MS
+	// returns the changed files, empty if the wait was interrupted
+	std::set<std::string> wait_changes() {
+		std::set<std::string> changed{};
+		int timeout = -1;
+		while (!stop_watching) {
+			pollfd pfd{ m_fd, POLLIN, 0 };
+			int res = poll(&pfd, 1, timeout);
+			if (res < 0) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			if (res == 0)
+				break;
+			alignas(inotify_event) char buf[0x4000];
+			ssize_t len = read(m_fd, buf, sizeof(buf));
+			if (len <= 0)
+				continue;
+			for (char* ptr = buf; ptr < buf + len;) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+				ptr += sizeof(inotify_event) + event->len;
+				auto wd = m_wds.find(event->wd);
+				if (wd == m_wds.end() || event->len == 0)
+					continue;
+				std::string name = event->name;
+				WatchedDir& watched = m_dirs[wd->second];
+				if ((event->mask & IN_ISDIR) && watched.sources) {
+					// a new sprite subfolder, its files count as well
+					if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+						std::string sub = wd->second + "/" + name;
+						m_dirs[sub].path = sub;
+						m_dirs[sub].sources = true;
+						add_watch(sub);
+					}
+					continue;
+				}
+				if (watched.names.count(name) || (watched.sources && is_source_file(name))) {
+					changed.insert(wd->second + "/" + name);
+					timeout = DEBOUNCE_MS;
+				}
+			}
+		}
+		if (stop_watching)
+			changed.clear();
+		return changed;
+	}
+};
+
+static std::string watch_key(const std::string& path) {
+	return std::filesystem::absolute(path).lexically_normal().generic_string();
+}
+
+static bool is_inside(const std::string& file, const std::string& dir) {
+	if (dir.empty())
+		return false;
+	std::string prefix = cleanPathTrail(watch_key(dir)) + "/";
+	return file.compare(0, prefix.size(), prefix) == 0;
+}
+
+// the list entries that use one of the changed files, through their descriptor, their asm file or anything it includes
+// a file that every entry is assembled with (routines, the asm folder, the configuration, ...) affects all of them,
+// then the only element is the reason why. empty if no listed sprite uses the changed files
+static std::vector<std::string> affected_entries(ResidentRom& resident, const std::set<std::string>& changed) {
+	const PixiConfig& cfg = resident.cfg;
+	std::set<std::string> shared{ watch_key("pixi_conf.toml"), watch_key(cfg.m_Paths[PathType::List]) };
+	for (int i = 0; i < FromEnum(ExtType::SIZE); i++) {
+		if (!cfg.m_Extensions[i].empty())
+			shared.insert(watch_key(cfg.m_Extensions[i]));
+	}
+	for (const std::string& file : changed) {
+		if (shared.count(file) || is_inside(file, cfg.m_Paths[PathType::Routines]) || is_inside(file, cfg.AsmDirPath))
+			return { fmt::format("every list entry, they all use {}", file) };
+	}
+
+	std::vector<std::string> affected{};
+	constexpr std::array<std::pair<ListType, std::string_view>, 3> lists{ {
+		{ ListType::Sprite, "SPRITE" }, { ListType::Cluster, "CLUSTER" }, { ListType::Extended, "EXTENDED" }
+	} };
+	for (const auto& [type, list] : lists) {
+		for (const Sprite& spr : (*resident.sprdata)[type].sprites) {
+			std::set<std::string> used{};
+			if (!spr.cfg_file.empty())
+				used.insert(watch_key(spr.cfg_file));
+			for (const std::string& source : { spr.asm_file, spr.directory + "_header.asm" }) {
+				if (source.empty())
+					continue;
+				for (const std::string& file : included_files(source))
+					used.insert(watch_key(file));
+			}
+			if (std::none_of(changed.begin(), changed.end(), [&used](const std::string& file) { return used.count(file) != 0; }))
+				continue;
+			std::string file = std::filesystem::path(spr.cfg_file.empty() ? spr.asm_file : spr.cfg_file).filename().string();
+			if (spr.level != 0x200)
+				affected.push_back(fmt::format("{} {:03X}:{:02X} {}", list, spr.level, spr.number, file));
+			else
+				affected.push_back(fmt::format("{} {:02X} {}", list, spr.number, file));
+		}
+	}
+	return affected;
+}
+
+int pixi_watch(int argc, char* argv[]) {
+	std::vector<std::string> args(argv + 2, argv + argc);
+	if (args.empty())
+		ErrorState::pixi_error("Usage: pixi --watch <options> <ROM>\n");
+	std::string pixi_exe = std::filesystem::absolute(argv[0]).string();
+
+	// the folders to watch, known even when the list or a descriptor can't be parsed
+	auto watched_config = [&]() {
+		std::vector<char*> cfg_args{};
+		cfg_args.push_back(const_cast<char*>(pixi_exe.c_str()));
+		for (const std::string& arg : args)
+			cfg_args.push_back(const_cast<char*>(arg.c_str()));
+		PixiConfig cfg{ (int)cfg_args.size(), cfg_args.data() };
+		cfg.correct_paths();
+		return cfg;
+	};
+
+	// the list and the descriptors stay parsed between insertions, nullptr while they can't be parsed
+	std::unique_ptr<ResidentRom> resident{};
+	auto parse = [&]() {
+		resident.reset();
+		try {
+			auto parsed = std::make_unique<ResidentRom>();
+			parsed->load(args, pixi_exe);
+			resident = std::move(parsed);
+		}
+		catch (const PixiException&) {
+			fmt::print("Waiting for the error to be fixed\n");
+		}
+	};
+	auto insert = [&]() {
+		if (resident == nullptr)
+			return 1;
+		try {
+			// the previous insertion wrote it
+			resident->refresh_rom();
+		}
+		catch (const PixiException&) {
+			return 1;
+		}
+		return resident->insert();
+	};
+
+	struct sigaction sa {};
+	sa.sa_handler = on_stop_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+
+	Watcher watcher{};
+	PixiConfig initial = watched_config();
+	if (initial.Help)
+		return 0;
+	watcher.setup(initial);
+	parse();
+	int retval = insert();
+	while (!stop_watching) {
+		fmt::print("\nWatching {} folders for changes, press Ctrl+C to stop\n", watcher.size());
+		fflush(stdout);
+		std::set<std::string> changed = watcher.wait_changes();
+		if (changed.empty())
+			break;
+		fmt::print("\nChanged:\n");
+		bool config_changed = false;
+		for (const std::string& file : changed) {
+			fmt::print("\t{}\n", file);
+			config_changed |= ends_with(file.c_str(), "/pixi_conf.toml");
+		}
+		// the paths to watch may have moved
+		if (config_changed) {
+			try {
+				watcher.setup(watched_config());
+			}
+			catch (const PixiException&) {
+				fmt::print("Keeping the previous set of watched folders\n");
+			}
+		}
+		if (resident == nullptr || resident->list_outdated()) {
+			parse();
+			retval = insert();
+			continue;
+		}
+		try {
+			for (const std::string& descriptor : resident->changed_descriptors())
+				resident->reparse(descriptor);
+		}
+		catch (const PixiException&) {
+			fmt::print("Waiting for the error to be fixed\n");
+			resident.reset();
+			retval = 1;
+			continue;
+		}
+		std::vector<std::string> affected = affected_entries(*resident, changed);
+		if (affected.empty()) {
+			fmt::print("No listed sprite uses the changed files, nothing to insert\n");
+			continue;
+		}
+		fmt::print("Affected:\n");
+		for (const std::string& entry : affected)
+			fmt::print("\t{}\n", entry);
+		retval = insert();
+	}
+	fmt::print("Stopped watching\n");
+	return retval;
+}
+
+#endif
\ No newline at end of file
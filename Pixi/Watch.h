@@ -0,0 +1,7 @@
+#pragma once
+
+// watch mode: `pixi --watch <options> <ROM>` inserts once and then again every time one of the inputs changes.
+// the inputs are the list, the sprite/routine/asm folders, the extension files and pixi_conf.toml.
+// the list and the descriptors stay parsed, only the descriptors that changed are parsed again, and a change that
+// no listed sprite uses doesn't insert anything. only available on Linux (inotify).
+int pixi_watch(int argc, char* argv[]);
\ No newline at end of file
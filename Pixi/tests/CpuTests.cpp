@@ -0,0 +1,150 @@
+#include "Cpu65816.h"
+#include "Rom.h"
+
+// the interpreter on a flat image with known cycle counts, then the timings SnesBus gives it for each -clock
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fmt::print("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+// 16 MB of memory where every access takes 8 master clocks and an internal operation 6, like SlowROM
+class FlatBus : public CpuBus {
+public:
+	std::vector<uint8_t> memory = std::vector<uint8_t>(0x1000000);
+
+	void put(uint32_t address, std::initializer_list<uint8_t> bytes) {
+		std::copy(bytes.begin(), bytes.end(), memory.begin() + address);
+	}
+
+	uint8_t read(uint32_t address) override { return memory[address & 0xFFFFFF]; }
+	void write(uint32_t address, uint8_t value) override { memory[address & 0xFFFFFF] = value; }
+	int clocks(uint32_t) override { return 8; }
+	int io_clocks() override { return 6; }
+};
+
+// runs the instruction at the pc and checks what it took, accesses * 8 + internal operations * 6 master clocks
+static void check_step(Cpu65816& cpu, uint32_t at, uint64_t cycles, uint64_t clocks) {
+	CHECK(cpu.address() == at);
+	cpu.cycles = 0;
+	cpu.clocks = 0;
+	cpu.step();
+	CHECK(!cpu.halted());
+	if (cpu.cycles != cycles || cpu.clocks != clocks)
+		fmt::print("${:06X}: {} cycles and {} master clocks, expected {} and {}\n", at, cpu.cycles, cpu.clocks, cycles, clocks);
+	CHECK(cpu.cycles == cycles);
+	CHECK(cpu.clocks == clocks);
+}
+
+static void test_cycle_counts() {
+	FlatBus bus{};
+	bus.put(0x008000, {
+		0xA9, 0x12,             // LDA #$12
+		0xA5, 0x10,             // LDA $10
+		0xC2, 0x20,             // REP #$20
+		0xA9, 0x34, 0x12,       // LDA #$1234
+		0xA5, 0x10,             // LDA $10
+		0x22, 0x00, 0x80, 0x01, // JSL $018000
+		0xE2, 0x20,             // SEP #$20
+		0xA5, 0x10              // LDA $10, with D not page aligned
+	});
+	bus.put(0x018000, { 0x6B });  // RTL
+	bus.put(0x000010, { 0xCD, 0xAB });
+	bus.put(0x000111, { 0x56 });
+
+	Cpu65816 cpu{ bus };
+	cpu.pc = 0x8000;
+	check_step(cpu, 0x008000, 2, 16);
+	CHECK((cpu.a & 0xFF) == 0x12);
+	check_step(cpu, 0x008002, 3, 24);
+	CHECK((cpu.a & 0xFF) == 0xCD);
+	check_step(cpu, 0x008004, 3, 22);
+	CHECK(!(cpu.p & Cpu65816::M));
+	check_step(cpu, 0x008006, 3, 24);
+	CHECK(cpu.a == 0x1234);
+	check_step(cpu, 0x008009, 4, 32);
+	CHECK(cpu.a == 0xABCD);
+	check_step(cpu, 0x00800B, 8, 62);
+	CHECK(cpu.s == 0x01FC);
+	check_step(cpu, 0x018000, 6, 44);
+	CHECK(cpu.s == 0x01FF);
+	check_step(cpu, 0x00800F, 3, 22);
+	cpu.d = 0x0101;
+	check_step(cpu, 0x008011, 4, 30);
+	CHECK((cpu.a & 0xFF) == 0x56);
+}
+
+// a rom of size bytes in memory, map_mode is the byte of the header that tells the mapper and the speed
+static std::vector<uint8_t> rom_image(size_t size, uint8_t map_mode) {
+	std::vector<uint8_t> image(size, 0);
+	image[0x7FD5] = map_mode;
+	// LDA #$12 at $008000
+	image[0x0000] = 0xA9;
+	image[0x0001] = 0x12;
+	return image;
+}
+
+static void test_bus_clocks() {
+	std::vector<uint8_t> lorom = rom_image(0x80000, 0x20);
+	size_t lorom_size = lorom.size();
+	Rom slow{ "lorom.smc", RomBuffer{ lorom.data(), &lorom_size, lorom.size() } };
+	SnesBus automatic{ slow };
+	CHECK(!automatic.sa1() && !automatic.sa1_clock() && !automatic.fastrom());
+	CHECK(automatic.clocks(0x008000) == 8);
+	CHECK(automatic.clocks(0x000010) == 8);
+	CHECK(automatic.io_clocks() == 6);
+
+	// the memory map stays LoROM's, only the timings are the SA-1's
+	SnesBus sa1{ slow, BusClock::Sa1 };
+	CHECK(!sa1.sa1() && sa1.sa1_clock());
+	CHECK(sa1.dp() == 0x0000);
+	CHECK(sa1.clocks(0x008000) == 2);
+	CHECK(sa1.io_clocks() == 2);
+	Cpu65816 cpu{ sa1 };
+	cpu.pc = 0x8000;
+	cpu.step();
+	CHECK(cpu.a == 0x12);
+	CHECK(cpu.cycles == 2);
+	CHECK(cpu.clocks == 4);
+
+	std::vector<uint8_t> fast = rom_image(0x80000, 0x30);
+	size_t fast_size = fast.size();
+	Rom fastrom{ "fastrom.smc", RomBuffer{ fast.data(), &fast_size, fast.size() } };
+	SnesBus fast_bus{ fastrom, BusClock::SCpu };
+	CHECK(fast_bus.fastrom());
+	CHECK(fast_bus.clocks(0x808000) == 6);
+	CHECK(fast_bus.clocks(0x008000) == 8);
+
+	std::vector<uint8_t> sa1rom = rom_image(0x80000, 0x23);
+	size_t sa1rom_size = sa1rom.size();
+	Rom sa1_rom{ "sa1.sfc", RomBuffer{ sa1rom.data(), &sa1rom_size, sa1rom.size() } };
+	SnesBus sa1_auto{ sa1_rom };
+	CHECK(sa1_auto.sa1() && sa1_auto.sa1_clock());
+	CHECK(sa1_auto.clocks(0x008000) == 2);
+	CHECK(sa1_auto.clocks(0x006000) == 4);
+	SnesBus scpu{ sa1_rom, BusClock::SCpu };
+	CHECK(scpu.sa1() && !scpu.sa1_clock());
+	CHECK(scpu.dp() == 0x3000);
+	CHECK(scpu.clocks(0x008000) == 8);
+	CHECK(scpu.io_clocks() == 6);
+}
+
+int main() {
+	try {
+		test_cycle_counts();
+		test_bus_clocks();
+	}
+	catch (const PixiException& e) {
+		fmt::print("Unexpected error: {}\n", e.what());
+		failures++;
+	}
+
+	if (failures > 0)
+		fmt::print("{} checks failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "Rom.h"
+
+// a rom that pixi already inserted into: sprite 00 runs code in a RATS protected block, which clean autocleans,
+// and the fake asar below assembles the next insertion of it somewhere else
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fmt::print("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+static constexpr size_t ROM_SIZE = 0x100000;
+static constexpr int OLD_BLOCK = 0x108000;
+static constexpr int KEPT_BLOCK = 0x108100;
+static constexpr int NEW_BLOCK = 0x128000;
+
+static size_t lorom_pc(int address) {
+	return ((address & 0x7F0000) >> 1) | (address & 0x7FFF);
+}
+
+static void put_rats_block(std::vector<uint8_t>& rom, int address, size_t size, uint8_t fill) {
+	size_t pc = lorom_pc(address);
+	uint16_t stored = (uint16_t)(size - 1);
+	const uint8_t tag[8] = { 'S', 'T', 'A', 'R', (uint8_t)stored, (uint8_t)(stored >> 8), (uint8_t)~stored, (uint8_t)(~stored >> 8) };
+	std::copy(std::begin(tag), std::end(tag), rom.begin() + pc);
+	std::fill_n(rom.begin() + pc + 8, size, fill);
+}
+
+static std::vector<uint8_t> inserted_rom() {
+	std::vector<uint8_t> rom(ROM_SIZE, 0);
+	auto put = [&rom](int address, std::initializer_list<uint8_t> bytes) {
+		std::copy(bytes.begin(), bytes.end(), rom.begin() + lorom_pc(address));
+	};
+	put(0x02FFE2, { 'S', 'T', 'S', 'D', PixiConfig::VERSION, 0x00 });
+	put(0x02FFEE, { 0x00, 0x80, 0x11 });
+	put(0x02FFF4, { 0xFF, 0xFF, 0xFF });
+	put(0x02FFFD, { 0xFF, 0xFF, 0xFF });
+	// cluster and extended tables where the original game has them
+	put(0x00A68A, { 0x98, 0x14, 0x9C });
+	put(0x029B1F, { 0xBC, 0x6F, 0x17 });
+	for (int slot = 0; slot < Rom::ROUTINE_SLOTS; slot++)
+		put(Rom::ROUTINE_POINTERS + slot * 3, { 0xFF, 0xFF, 0xFF });
+	for (int number = 0; number < 0x100; number++) {
+		put(0x118008 + number * 0x10, { Pointer::RTL_LOW, Pointer::RTL_HIGH, Pointer::RTL_BANK });
+		put(0x11800B + number * 0x10, { Pointer::RTL_LOW, Pointer::RTL_HIGH, Pointer::RTL_BANK });
+	}
+	put(0x118008, { 0x08, 0x80, 0x10 });
+	put(0x11800B, { 0x10, 0x80, 0x10 });
+	put_rats_block(rom, OLD_BLOCK, 0x40, 0x6B);
+	// something another tool inserted, nothing autocleans it
+	put_rats_block(rom, KEPT_BLOCK, 0x20, 0xEA);
+	return rom;
+}
+
+namespace fake_asar {
+	std::vector<writtenblockdata> blocks{};
+
+	// clears the block of every autoclean like asar does, then writes the new code of the sprite
+	bool patch_ex(const patchparams* params) {
+		blocks.clear();
+		uint8_t* rom = reinterpret_cast<uint8_t*>(params->romdata);
+		for (int i = 0; i < params->memory_file_count; i++) {
+			std::string_view text{ static_cast<const char*>(params->memory_files[i].buffer), params->memory_files[i].length };
+			for (size_t pos = text.find("autoclean $"); pos != std::string_view::npos; pos = text.find("autoclean $", pos + 1)) {
+				size_t pc = lorom_pc(std::stoi(std::string{ text.substr(pos + 11, 6) }, nullptr, 16));
+				for (size_t tag = pc - 8; tag + 0x10000 > pc; tag--) {
+					if (memcmp(rom + tag, "STAR", 4) != 0)
+						continue;
+					size_t size = (rom[tag + 4] | (rom[tag + 5] << 8)) + 1;
+					if (pc < tag + 8 + size)
+						std::fill_n(rom + tag, 8 + size, 0);
+					break;
+				}
+			}
+		}
+		std::vector<uint8_t> block(ROM_SIZE, 0);
+		put_rats_block(block, NEW_BLOCK, 0x20, 0x6B);
+		size_t pc = lorom_pc(NEW_BLOCK);
+		memcpy(rom + pc, block.data() + pc, 0x28);
+		blocks.push_back({ (int)pc, NEW_BLOCK, 0x28 });
+		return true;
+	}
+
+	const writtenblockdata* written_blocks(int* count) {
+		*count = (int)blocks.size();
+		return blocks.data();
+	}
+
+	const errordata* nothing(int* count) {
+		*count = 0;
+		return nullptr;
+	}
+
+	void install() {
+		asar_patch_ex = patch_ex;
+		asar_getwrittenblocks = written_blocks;
+		asar_geterrors = nothing;
+		asar_getwarnings = nothing;
+	}
+}
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+	FILE* fp = fileopen(path.c_str(), "rb");
+	std::vector<uint8_t> data(filesize(fp));
+	size_t read = fread(data.data(), 1, data.size(), fp);
+	fclose(fp);
+	data.resize(read);
+	return data;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& data) {
+	FILE* fp = fileopen(path.c_str(), "wb");
+	fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+}
+
+static std::vector<uint8_t> rom_content(Rom& rom) {
+	std::vector<uint8_t> data(ROM_SIZE);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = rom.at(i);
+	return data;
+}
+
+static std::vector<uint8_t> apply_ips(std::vector<uint8_t> rom, const std::vector<uint8_t>& patch) {
+	size_t pos = 5;
+	while (pos + 3 <= patch.size() && memcmp(patch.data() + pos, "EOF", 3) != 0) {
+		size_t offset = (patch[pos] << 16) | (patch[pos + 1] << 8) | patch[pos + 2];
+		size_t len = (patch[pos + 3] << 8) | patch[pos + 4];
+		pos += 5;
+		if (offset + len > rom.size())
+			rom.resize(offset + len);
+		std::copy(patch.begin() + pos, patch.begin() + pos + len, rom.begin() + offset);
+		pos += len;
+	}
+	return rom;
+}
+
+static std::vector<uint8_t> apply_bps(const std::vector<uint8_t>& source, const std::vector<uint8_t>& patch) {
+	size_t pos = 4;
+	auto decode = [&patch, &pos]() {
+		uint64_t value = 0;
+		uint64_t shift = 1;
+		while (true) {
+			uint8_t byte = patch[pos++];
+			value += (byte & 0x7F) * shift;
+			if (byte & 0x80)
+				return value;
+			shift <<= 7;
+			value += shift;
+		}
+	};
+	decode();
+	std::vector<uint8_t> target(decode());
+	pos += decode();
+	size_t out = 0;
+	int64_t source_rel = 0;
+	int64_t target_rel = 0;
+	while (pos < patch.size() - 12) {
+		uint64_t action = decode();
+		size_t len = (action >> 2) + 1;
+		switch (action & 3) {
+		case 0:
+			std::copy_n(source.begin() + out, len, target.begin() + out);
+			break;
+		case 1:
+			std::copy_n(patch.begin() + pos, len, target.begin() + out);
+			pos += len;
+			break;
+		case 2:
+		case 3: {
+			uint64_t data = decode();
+			int64_t& rel = (action & 3) == 2 ? source_rel : target_rel;
+			rel += (data & 1 ? -1 : 1) * (int64_t)(data >> 1);
+			const std::vector<uint8_t>& from = (action & 3) == 2 ? source : target;
+			for (size_t i = 0; i < len; i++)
+				target[out + i] = from[rel++];
+			break;
+		}
+		}
+		out += len;
+	}
+	return target;
+}
+
+// what an insertion does to the rom before the sprites: clean, then the first patch also does the autocleans
+static void insert_sprite(Rom& rom, PixiConfig& cfg) {
+	if (cfg.Output == RomOutput::Bps)
+		rom.record_source();
+	rom.clean(cfg);
+	MemoryFile sprite{ cfg.AsmDir + "sprite.asm", false };
+	sprite.insertString("; the sprite\n");
+	rom.patch(sprite, cfg);
+}
+
+static void test_patch_covers_cleaned_blocks(PixiConfig& cfg, const std::string& rom_path, RomOutput output) {
+	const std::vector<uint8_t> original = inserted_rom();
+	write_file(rom_path, original);
+	cfg.Output = output;
+	Rom rom{ rom_path };
+	insert_sprite(rom, cfg);
+	rom.close(cfg);
+	std::vector<uint8_t> inserted = rom_content(rom);
+	CHECK(memcmp(inserted.data() + lorom_pc(OLD_BLOCK), "STAR", 4) != 0);
+	CHECK(memcmp(inserted.data() + lorom_pc(KEPT_BLOCK), "STAR", 4) == 0);
+	CHECK(memcmp(inserted.data() + lorom_pc(NEW_BLOCK), "STAR", 4) == 0);
+
+	CHECK(read_file(rom_path) == original);
+	std::vector<uint8_t> patch = read_file(subfile_name(rom_path, output == RomOutput::Ips ? "ips" : "bps"));
+	std::vector<uint8_t> patched = output == RomOutput::Ips ? apply_ips(original, patch) : apply_bps(original, patch);
+	CHECK(patched == inserted);
+	if (output == RomOutput::Bps) {
+		uint32_t target_crc = patch[patch.size() - 8] | (patch[patch.size() - 7] << 8) | (patch[patch.size() - 6] << 16) | ((uint32_t)patch[patch.size() - 5] << 24);
+		CHECK(target_crc == crc32(patched.data(), patched.size()));
+	}
+}
+
+// what MeiMei does when it fails: the rom goes back to what was loaded, blocks clean freed included
+static void test_rollback_restores_cleaned_blocks(PixiConfig& cfg, const std::string& rom_path) {
+	const std::vector<uint8_t> original = inserted_rom();
+	write_file(rom_path, original);
+	cfg.Output = RomOutput::Rom;
+	Rom rom{ rom_path };
+	insert_sprite(rom, cfg);
+	CHECK(rom_content(rom) != original);
+	rom.rollback(rom.loaded());
+	CHECK(rom_content(rom) == original);
+	CHECK(rom.size() == (int)ROM_SIZE);
+}
+
+int main() {
+	fake_asar::install();
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "pixi_rom_tests";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir / "routines");
+	std::filesystem::create_directories(dir / "asm");
+
+	PixiConfig cfg{};
+	cfg.m_Paths[PathType::Routines] = (dir / "routines").generic_string() + "/";
+	cfg.AsmDir = (dir / "asm").generic_string() + "/";
+	cfg.AsmDirPath = (dir / "asm").generic_string();
+	std::string rom_path = (dir / "rom.smc").generic_string();
+
+	try {
+		test_patch_covers_cleaned_blocks(cfg, rom_path, RomOutput::Ips);
+		test_patch_covers_cleaned_blocks(cfg, rom_path, RomOutput::Bps);
+		test_rollback_restores_cleaned_blocks(cfg, rom_path);
+	}
+	catch (const PixiException& e) {
+		fmt::print("Unexpected error: {}\n", e.what());
+		failures++;
+	}
+
+	std::filesystem::remove_all(dir);
+	if (failures > 0)
+		fmt::print("{} checks failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "Routines.h"
+
+// which shared routines get a macro: the ones the sprites are seen calling, or all of them when the scan can't see everything
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fmt::print("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<std::string> warnings{};
+
+static void collect_warning(MessageKind kind, const char* message, void*) {
+	if (kind == MessageKind::Warning)
+		warnings.emplace_back(message);
+}
+
+static void write_file(const std::filesystem::path& path, std::string_view text) {
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream file{ path };
+	file << text;
+}
+
+static std::set<std::string> used_by(const std::filesystem::path& sprite, std::string_view text, const std::vector<SharedRoutine>& routines) {
+	write_file(sprite, text);
+	warnings.clear();
+	return find_used_routines({ sprite.generic_string(), (sprite.parent_path() / "_header.asm").generic_string() }, routines);
+}
+
+static bool warned_about(std::string_view what) {
+	return warnings.size() == 1 && warnings.front().find(what) != std::string::npos;
+}
+
+int main() {
+	std::filesystem::path dir = std::filesystem::temp_directory_path() / "pixi_routines_tests";
+	std::filesystem::remove_all(dir);
+	// A calls B, and C through a file it includes
+	write_file(dir / "routines" / "A.asm", "incsrc \"lib/a.asm\"\n%B()\nRTL\n");
+	write_file(dir / "routines" / "lib" / "a.asm", "%C() ; the rest of A\n");
+	write_file(dir / "routines" / "B.asm", "RTL\n");
+	write_file(dir / "routines" / "C.asm", "RTL\n");
+	write_file(dir / "routines" / "D.asm", "RTL\n");
+	write_file(dir / "sprites" / "lib" / "draw.asm", "%D()\n");
+
+	PixiConfig cfg{};
+	cfg.m_Paths[PathType::Routines] = (dir / "routines").generic_string() + "/";
+	ErrorState::message_handler = collect_warning;
+	const std::set<std::string> all{ "A", "B", "C", "D" };
+	std::filesystem::path sprite = dir / "sprites" / "sprite.asm";
+
+	try {
+		std::vector<SharedRoutine> routines = list_shared_routines(cfg, 0);
+
+		CHECK((used_by(sprite, "%A()\nincsrc \"lib/draw.asm\"\n", routines) == all));
+		CHECK(warnings.empty());
+		CHECK((used_by(sprite, "%B() ; %A()\n", routines) == std::set<std::string>{ "B" }));
+		CHECK(warnings.empty());
+
+		// what the scan can't follow falls back to every routine, and says why
+		CHECK(used_by(sprite, "!libdir = lib\nincsrc \"!libdir/draw.asm\"\n%B()\n", routines) == all);
+		CHECK(warned_about("!libdir/draw.asm"));
+		CHECK(used_by(sprite, "macro call(r)\n\t%<r>()\nendmacro\n%call(B)\n", routines) == all);
+		CHECK(warned_about("%<r>()"));
+		CHECK(used_by(sprite, "incsrc \"lib/missing.asm\"\n", routines) == all);
+		CHECK(warned_about("missing.asm"));
+		CHECK(used_by(sprite, "incbin \"!libdir/gfx.bin\"\n%B()\n", routines) == std::set<std::string>{ "B" });
+		CHECK(warnings.empty());
+	}
+	catch (const PixiException& e) {
+		fmt::print("Unexpected error: {}\n", e.what());
+		failures++;
+	}
+
+	ErrorState::message_handler = nullptr;
+	std::filesystem::remove_all(dir);
+	if (failures > 0)
+		fmt::print("{} checks failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
\ No newline at end of file
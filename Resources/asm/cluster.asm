@@ -18,6 +18,10 @@ NotQuiteMain:
 	STZ $149A|!Base2      ; \ Hijack restore code.
 	STZ $1498|!Base2      ; | 
 	STZ $1495|!Base2      ; /
+	if !PerLevel = 1
+		LDA #$FF                     ; \ no level has this number, the per-level
+		STA !perlevel_cache_level+1  ; / sprites of the new one are fetched again
+	endif
 	REP #$20
 	LDX #$9E              ; \ Set $1E02-$1EA1 to zero on level load.
 .loop                    ; |
@@ -1,2 +1,4 @@
 !PerLevel = 0
-!Disable255SpritesPerLevel = 0
\ No newline at end of file
+!Disable255SpritesPerLevel = 0
+!FastROM = 0
+!PlanarPointers = 0
\ No newline at end of file
@@ -8,8 +8,9 @@ incsrc "pointer_caller.asm"
 org $02FFE2
 	db "STSD"						;header!
 	incbin "_versionflag.bin"	;byte 1 is version number 1.xx
-										;byte 2 are flags ---- ---l
+										;byte 2 are flags ---- --pl
                               ; l = per level sprites code inserted
+                              ; p = planar pointer tables (-planar)
                               ;byte 3,4 reserved
                               
 ;$02FFEA
@@ -23,15 +24,15 @@ TableLoc:
 	; but the above makes access easier and these are for cleanup.
    if !PerLevel = 1
         autoclean dl PerLevelLvlPtrs
-		dl $FFFFFF
-		dl $FFFFFF
-		dl $FFFFFF
    else
         dl $FFFFFF
+   endif
+	
+;$02FFF4
+	; hashes of the shared routines in the table at $03E05C, routines that didn't change aren't inserted again
+	autoclean dl RoutineHashes
 		dl $FFFFFF
 		dl $FFFFFF
-		dl $FFFFFF
-   endif
 	
 	; Use this for custom status pointer tables
 	autoclean dl CustomStatusPtr
@@ -187,6 +188,10 @@ freedata
 Size:
 	incbin "DefaultSize.bin"
 	incbin "_CustomSize.bin"
+
+freedata
+RoutineHashes:
+	incbin "_RoutineHashes.bin"
 	
 
 org $02A846|!BankB
@@ -568,14 +573,50 @@ endif
 	RTL
 .IsCustom
 	LDA !new_sprite_num,x
-	JSR GetMainPtr
-
+	CMP !main_cache_num,x
+	BNE .uncached
+	LDA !main_cache_low,x
+	STA $00
+	LDA !main_cache_high,x
+	STA $01
+	LDA !main_cache_bank,x
+	STA $02
+.call
 	PLA
 	PLA
 
 	PEA $85C1
 	LDA !14C8,x
 	JML [!Base1]
+.uncached
+	JSR CacheMainPtr
+	BRA .call
+
+; pointer to the MAIN of the sprite in slot x in [$00], from the cache if it's for the same sprite number
+GetCachedMainPtr:
+	LDA !new_sprite_num,x
+	CMP !main_cache_num,x
+	BNE CacheMainPtr
+	LDA !main_cache_low,x
+	STA $00
+	LDA !main_cache_high,x
+	STA $01
+	LDA !main_cache_bank,x
+	STA $02
+	RTS
+
+; Input, A=Sprite number of slot x, resolves its MAIN pointer and caches it
+CacheMainPtr:
+	%debugmsg("CacheMainPtr")
+	STA !main_cache_num,x
+	JSR GetMainPtr
+	LDA $00
+	STA !main_cache_low,x
+	LDA $01
+	STA !main_cache_high,x
+	LDA $02
+	STA !main_cache_bank,x
+	RTS
 
 GetMainPtr:
 	%debugmsg("GetMainPtr")
@@ -609,18 +650,17 @@ GetMainPtr:
 	
    if !PerLevel = 1
 	.perlevel
-		JSR GetPerLevelAddr
+		JSR GetPerLevelCacheAddr
 		BNE +
-		PHK
-		PLB
-		LDA $00
+		TYA
 		BRA -
-	+	PEA.w PerLevelTable>>8
-		PLB
-		PLB
-		LDA.w PerLevelTable+$0B,y			; load low-high byte of pointer
+	+	LDY #$000C
+		LDA [$00],y								; load high-bank byte of pointer
+		PHA
+		DEY
+		LDA [$00],y								; load low-high byte of pointer
 		STA $00									; 00=low, 01=high, 02=x
-		LDA.w PerLevelTable+$0C,y			; load high-bank byte of pointer
+		PLA
 		STA $01									; 00=low, 01=high, 02=bank
 		PLP
 		PLB
@@ -653,6 +693,91 @@ if !PerLevel = 1
 		PLB
 		TAY
 		RTS
+
+	; Input, A=Sprite number (inbetween B0-BF), 16 bit A and index
+	; Output, [$00]=its entry in !perlevel_cache, Y=A*2, zero flag set if the level has no per-level sprite with that number
+	GetPerLevelCacheAddr:
+		ASL
+		PHA
+		LDA $010B|!Base2
+		CMP !perlevel_cache_level
+		BEQ +
+		JSR FillPerLevelCache
+	+	PLA
+		TAY
+		AND #$001E
+		ASL #3
+		CLC
+		ADC.w #!perlevel_cache&$FFFF
+		STA $00
+		SEP #$20
+		LDA.b #!perlevel_cache>>16
+		STA $02
+		LDA [$00]
+		INC A					; $FF = no per-level sprite
+		REP #$20				; keeps the zero flag
+		RTS
+
+	; Input, A=Level number, 16 bit A and index
+	; copies the 16 per-level sprite entries of the level to !perlevel_cache
+	FillPerLevelCache:
+		%debugmsg("FillPerLevelCache")
+		STA !perlevel_cache_level
+		PHX
+		PHB
+		ASL
+		TAY
+		PEA.w ((PerLevelLvlPtrs>>16)<<8)|(PerLevelSprPtrs>>16)
+		PLB
+		; now in PerLevelLvlPtrs bank
+		LDA.w PerLevelLvlPtrs,y
+		PLB
+		; now in PerLevelSprPtrs bank
+		TAY
+		LDX #$0000
+	.sprite
+		LDA #$00FF
+		STA !perlevel_cache,x
+		TYA
+		BEQ .next				; the level has no per-level sprites
+		LDA.w PerLevelSprPtrs,y
+		INY #2
+		CMP #$0000
+		BEQ .next
+		PHY
+		PHB
+		PEA.w PerLevelTable>>8
+		PLB
+		PLB
+		TAY
+		LDA.w PerLevelTable+$00,y
+		STA !perlevel_cache+$00,x
+		LDA.w PerLevelTable+$02,y
+		STA !perlevel_cache+$02,x
+		LDA.w PerLevelTable+$04,y
+		STA !perlevel_cache+$04,x
+		LDA.w PerLevelTable+$06,y
+		STA !perlevel_cache+$06,x
+		LDA.w PerLevelTable+$08,y
+		STA !perlevel_cache+$08,x
+		LDA.w PerLevelTable+$0A,y
+		STA !perlevel_cache+$0A,x
+		LDA.w PerLevelTable+$0C,y
+		STA !perlevel_cache+$0C,x
+		LDA.w PerLevelTable+$0E,y
+		STA !perlevel_cache+$0E,x
+		PLB
+		PLY
+	.next
+		TXA
+		CLC
+		ADC #$0010
+		TAX
+		CPX #$0100
+		BNE .sprite
+		PLB
+		PLX
+		RTS
 endif
 	
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
@@ -1040,6 +1165,14 @@ SetSpriteTables:
 	RTL
 
 .IsCustomNormal
+	LDA TableStart+$0B,y
+	STA !main_cache_low,x
+	LDA TableStart+$0C,y
+	STA !main_cache_high,x
+	LDA TableStart+$0D,y
+	STA !main_cache_bank,x
+	LDA !new_sprite_num,x
+	STA !main_cache_num,x
 	REP #$20
 	LDA TableStart+$08,y
 	STA $00
@@ -1059,43 +1192,64 @@ SetSpriteTables:
 	
    if !PerLevel = 1
 	.perlevel
-		JSR GetPerLevelAddr
+		JSR GetPerLevelCacheAddr
 		BNE +
-		PHK
-		PLB
-		LDA $00
+		TYA
 		BRA -
-	+	PEA.w PerLevelTable>>8
-		PLB
-		PLB
-		SEP #$20
-		LDA.w PerLevelTable+$01,y
+	+	SEP #$20
+		LDY #$0001
+		LDA [$00],y
 		STA !9E,x
-		LDA.w PerLevelTable+$02,y
+		INY
+		LDA [$00],y
 		STA !1656,x
-		LDA.w PerLevelTable+$03,y
+		INY
+		LDA [$00],y
 		STA !1662,x
-		LDA.w PerLevelTable+$04,y
+		INY
+		LDA [$00],y
 		STA !166E,x
 		AND #$0F
 		STA !15F6,x
-		LDA.w PerLevelTable+$05,y
+		INY
+		LDA [$00],y
 		STA !167A,x
-		LDA.w PerLevelTable+$06,y
+		INY
+		LDA [$00],y
 		STA !1686,x
-		LDA.w PerLevelTable+$07,y
+		INY
+		LDA [$00],y
 		STA !190F,x
-		LDA.w PerLevelTable+$00,y
+		LDA [$00]
 		STA !new_code_flag
 		BEQ .notCustom
-		LDA.w PerLevelTable+$0E,y
+		LDY #$000B
+		LDA [$00],y
+		STA !main_cache_low,x
+		INY
+		LDA [$00],y
+		STA !main_cache_high,x
+		INY
+		LDA [$00],y
+		STA !main_cache_bank,x
+		LDA !new_sprite_num,x
+		STA !main_cache_num,x
+		INY
+		LDA [$00],y
 		STA !extra_prop_1,x
-		LDA.w PerLevelTable+$0F,y
+		INY
+		LDA [$00],y
 		STA !extra_prop_2,x
-		LDA.w PerLevelTable+$0A,y
+		REP #$20
+		LDY #$0008
+		LDA [$00],y
+		PHA
+		SEP #$20
+		LDY #$000A
+		LDA [$00],y
 		STA $02
 		REP #$20
-		LDA.w PerLevelTable+$08,y
+		PLA
 		STA $00					; INIT pointer to [$00]
 		BRA .ret
    endif
@@ -1144,8 +1298,7 @@ SubHandleStatus:
 CallMain2:
 	PHA
 CallMain:
-	LDA !new_sprite_num,x
-	JSR GetMainPtr
+	JSR GetCachedMainPtr
 	PLA
 
 	LDY.b #$01|(!BankB>>16)	;\
@@ -1,26 +1,37 @@
 @include
+includeonce
 
 ;input:  A     = Custom Sprite Number
 ;        X     = Sprite RAM Index
-;        label = 3 byte Pointer label
+;        label = 3 byte Pointer label, or with !PlanarPointers
+;                the low, high and bank bytes of $80 pointers one after the other
 macro CallSprite(label)
 	PHX                   ; \ Preserve X and Y.
 	PHY                   ; /
 	
 	TXY                   ; save x in y	
-	REP #$30              ; \ 16 bit indexing and math
-	AND #$00FF            ; / clear high byte
+	if !PlanarPointers
+		TAX                   ; x = A
+
+		;pointer in [$00]
+		LDA.l <label>,x : STA $00
+		LDA.l <label>+$80,x : STA $01
+		LDA.l <label>+$100,x : STA $02
+	else
+		REP #$30              ; \ 16 bit indexing and math
+		AND #$00FF            ; / clear high byte
 	
-	STA $00               ; \
-	ASL A		             ; |
-	CLC : ADC $00         ; | x = A*3
-	TAX                   ; /
+		STA $00               ; \
+		ASL A		             ; |
+		CLC : ADC $00         ; | x = A*3
+		TAX                   ; /
 	
-	;pointer in [$00]
-	LDA.l <label>+0,x : STA $00
-	SEP #$20
-	LDA.l <label>+2,x : STA $02
-	SEP #$10
+		;pointer in [$00]
+		LDA.l <label>+0,x : STA $00
+		SEP #$20
+		LDA.l <label>+2,x : STA $02
+		SEP #$10
+	endif
 		
 	TYX	                ; put y back in x
 		
@@ -40,18 +51,26 @@ macro CallExtCape(label)
 	PHY
 
 	TXY
-	REP #$30
-	AND #$00FF
-
-	STA $00
-	ASL A
-	CLC : ADC $00
-	TAX
-
-	LDA.l <label>+0,x : STA $00
-	SEP #$20
-	LDA.l <label>+2,x : STA $02
-	SEP #$10
+	if !PlanarPointers
+		TAX
+
+		LDA.l <label>,x : STA $00
+		LDA.l <label>+$80,x : STA $01
+		LDA.l <label>+$100,x : STA $02
+	else
+		REP #$30
+		AND #$00FF
+
+		STA $00
+		ASL A
+		CLC : ADC $00
+		TAX
+
+		LDA.l <label>+0,x : STA $00
+		SEP #$20
+		LDA.l <label>+2,x : STA $02
+		SEP #$10
+	endif
 
 	BNE ?runCustom
 	PLY : PLX
@@ -75,46 +94,78 @@ endmacro
 ;input:  A     = Custom Sprite Number
 ;        X     = Sprite RAM Index
 ;		 $03   = Status
-;        label = 3 byte Pointer label
+;        label = 3 byte Pointer label, or with !PlanarPointers
+;                $100 bytes for the low, high and bank byte of each status
 
 macro CallStatusPtr(label, indextable, vanillaroutine)
 	PHX                   ; \ Preserve X and Y.
 	PHY                   ; /
 
-	PHA					  ; preserve custom sprite number
-	TXY                   ; save x in y	
-	LDA $03
-	SEC : SBC #$07
-	TAX
-	LDA.l <indextable>, x
-	STZ $04				  ; setting high byte of $03 to 00 for later
-	STA $03
-	; $09 => 00, $0A => 03, $0B => 06, $0C => 12, $07 => 09
-	PLA					  ; 
-	REP #$30              ; \ 16 bit indexing and math
-	AND #$00FF            ; / clear high byte
+	if !PlanarPointers
+		TAY                   ; y = custom sprite number
+		LDA $03
+		SEC : SBC #$07
+		TAX
+		LDA.l <indextable>, x
+		; $09 => 00, $0A => 03, $0B => 06, $0C => 12, $07 => 09
+		CLC : ADC.b #(<label>>>8)&$FF
+		STA $04               ; \
+		LDA.b #<label>&$FF    ; | [$03] = low bytes of the status
+		STA $03               ; | the table doesn't cross a bank, so
+		LDA.b #<label>>>16    ; | the high byte never carries
+		STA $05               ; /
+
+		;pointer in [$00]
+		LDA [$03],y : STA $00
+		INC $04
+		LDA [$03],y : STA $01
+		INC $04
+		LDA [$03],y : STA $02
+
+		BNE ?continue
+		PLY : PLX
+		LDA !14C8,x
+		JMP <vanillaroutine>
+		?continue
+
+		LDA $02,s : TAX       ; put x back
+		LDA $02
+	else
+		PHA					  ; preserve custom sprite number
+		TXY                   ; save x in y	
+		LDA $03
+		SEC : SBC #$07
+		TAX
+		LDA.l <indextable>, x
+		STZ $04				  ; setting high byte of $03 to 00 for later
+		STA $03
+		; $09 => 00, $0A => 03, $0B => 06, $0C => 12, $07 => 09
+		PLA					  ; 
+		REP #$30              ; \ 16 bit indexing and math
+		AND #$00FF            ; / clear high byte
 	
-	STA $00               ; \
-	ASL #4		          ; |
-	SEC : SBC $00         	  ; | x = A*15 + (status * 3)
+		STA $00               ; \
+		ASL #4		          ; |
+		SEC : SBC $00         	  ; | x = A*15 + (status * 3)
 
-	CLC : ADC $03
+		CLC : ADC $03
 
-	TAX                   ; /
+		TAX                   ; /
 	
-	;pointer in [$00]
-	LDA.l <label>+0,x : STA $00
-	SEP #$20
-	LDA.l <label>+2,x : STA $02
-	SEP #$10
-
-	BNE ?continue
-	PLY : PLX
-	LDA !14C8,x
-	JMP <vanillaroutine>
-	?continue
-
-	TYX	                ; put y back in x
+		;pointer in [$00]
+		LDA.l <label>+0,x : STA $00
+		SEP #$20
+		LDA.l <label>+2,x : STA $02
+		SEP #$10
+
+		BNE ?continue
+		PLY : PLX
+		LDA !14C8,x
+		JMP <vanillaroutine>
+		?continue
+
+		TYX	                ; put y back in x
+	endif
 		
 	PHB : PHA : PLB       ; set bank to cluster sprite bank	
 	PHK                   ; \
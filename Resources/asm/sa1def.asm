@@ -1,9 +1,12 @@
+includeonce
+
 if canreadfile1("config.asm",0) != 0
 	incsrc "config.asm"
 endif
 
 !PerLevel ?= 0
 !Disable255SpritesPerLevel ?= 0
+!PlanarPointers ?= 0
 
 ;only works for SA-1 version 1.10+
 
@@ -152,6 +155,18 @@ endmacro
 %define_sprite_table("shooter_extra_byte_2",$7FAC08,$6030)
 %define_sprite_table("shooter_extra_byte_3",$7FAC10,$6038)
 
+; MAIN pointer of the custom sprite in each slot, set by SetSpriteTables
+; it's only used while main_cache_num matches !new_sprite_num
+%define_sprite_table("main_cache_low",$7FAC18,$418B00)
+%define_sprite_table("main_cache_high",$7FAC24,$418B16)
+%define_sprite_table("main_cache_bank",$7FAC30,$418B2C)
+%define_sprite_table("main_cache_num",$7FAC3C,$418B42)
+
+; the entries of the per-level sprites B0-BF of the current level, $FF as first byte if it has none for that number
+; filled when the first one spawns in a level, the level load hijack of cluster.asm sets the level number to an invalid one
+%define_sprite_table("perlevel_cache",$7FAD00,$418C00)
+%define_sprite_table("perlevel_cache_level",$7FAE00,$418D00)
+
 ;%define_sprite_table(shoot_misc,$7FAB64,$4000DB)
 
 ;shooter defines